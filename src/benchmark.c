@@ -0,0 +1,177 @@
+/*
+Renderer benchmark. Runs the same scripted game scene through every render driver SDL has on this machine and prints frame time percentiles
+and draw call throughput for each, so the renderer setting can be picked per machine from data.
+
+usage: ./bin/benchmark [level] [frames] [vsync]   (defaults to levels/official/1.lvl, 600 frames and vsync off)
+
+The scene does not depend on the physics: the ship flies a fixed path over the whole map with both thrusters on, and the boost trail and force
+particles switch on and off every couple of seconds, so every driver draws exactly the same frames.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include <SDL_mixer.h>
+
+#include "lib.c"
+#include "game.c"
+
+#define WARMUP_FRAMES 60 
+#define SCENE_DELTA_TIME (1/60.0) // scene time per frame, the same however fast the driver is 
+
+struct BenchmarkResult {
+    float p50, p90, p99, max; // frame times in ms 
+    float average; 
+    float draws_per_frame; 
+    float draws_per_second, quads_per_second; 
+}; 
+
+// moves the ship along the scripted path and emits its particles, time is the scene time of the frame 
+void update_scene(struct Game *game, float time) {
+    struct Player *player = &game->player; 
+    float range_x = MAP_W/2.0 - 2, range_y = MAP_H/2.0 - 2; 
+    player->x = MAP_W/2.0 + range_x * sinf(time * 0.5); 
+    player->y = MAP_H/2.0 + range_y * sinf(time * 0.7); 
+    player->vel_x = range_x * 0.5 * cosf(time * 0.5); 
+    player->vel_y = range_y * 0.7 * cosf(time * 0.7); 
+    player->rot = time; 
+    player->rot_vel = 1; 
+
+    player->left_thruster_control = player->right_thruster_control = 1; 
+    memset(player->collision_cache, 0, sizeof(player->collision_cache)); 
+    player->collision_cache[Boost] = (int)time % 2; 
+    player->collision_cache[LeftForce] = (int)(time / 2) % 2; 
+
+    update_particles(&player->particles, ThrusterEmitter, SCENE_DELTA_TIME, 3.0, game->map); 
+    emit_player_particles(player, SCENE_DELTA_TIME, 1); 
+    update_particles(&player->particles, ForceEmitter, SCENE_DELTA_TIME, 3.0, game->map); 
+    emit_player_force_particles(player, SCENE_DELTA_TIME, 1); 
+}
+
+int compare_floats(const void *a, const void *b) {
+    float first = *(const float*)a, second = *(const float*)b; 
+    return first < second? -1: first > second; 
+}
+
+// returns 0 if the driver could not be used on this machine 
+int run_benchmark(int driver, char *level_path, int num_frames, int vsync, struct BenchmarkResult *result) {
+    SDL_Window *window = SDL_CreateWindow("Rolleron benchmark", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, 0); 
+    SDL_RendererInfo info; 
+    SDL_GetRenderDriverInfo(driver, &info); 
+    Uint32 flags = (strcmp(info.name, "software") == 0? SDL_RENDERER_SOFTWARE: SDL_RENDERER_ACCELERATED) | (vsync? SDL_RENDERER_PRESENTVSYNC: 0); 
+    // no fallback here unlike create_renderer, a driver that fails is just reported 
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, driver, flags); 
+    if (renderer == NULL) {
+        SDL_DestroyWindow(window); 
+        return 0; 
+    }
+
+    TTF_Font *font = TTF_OpenFont("assets/conthrax.otf", 64); 
+    struct Glyphs glyphs; 
+    init_glyphs(&glyphs, font, renderer); 
+    struct RenderQueue queue; 
+    init_render_queue(&queue, renderer); 
+
+    // only what render_game draws, like the replay renderer (there is no audio device, so the sounds stay null) 
+    struct Game *game = malloc(sizeof(struct Game)); 
+    memset(game, 0, sizeof(*game)); 
+    SDL_AtomicSet(&game->quality_level, NUM_QUALITY_LEVELS - 1); 
+    game->low_res_tiles = IMG_LoadTexture(renderer, "assets/low_res_tiles.png"); 
+    game->high_res_tiles = IMG_LoadTexture(renderer, "assets/high_res_tiles.png"); 
+    game->player.texture = IMG_LoadTexture(renderer, "assets/space_ship.png"); 
+    game->player.drag_creasent = IMG_LoadTexture(renderer, "assets/drag_creasent.png"); 
+    enter_game(game, level_path, font, renderer); 
+
+    float *frame_times = malloc(num_frames * sizeof(float)); 
+    double total_time = 0; 
+    Uint64 frequency = SDL_GetPerformanceFrequency(); 
+    for (int frame = -WARMUP_FRAMES; frame < num_frames; ++frame) {
+        SDL_PumpEvents(); 
+        update_scene(game, (frame + WARMUP_FRAMES) * SCENE_DELTA_TIME); 
+        publish_game_snapshot(game); 
+        if (frame == 0) queue.num_draws = queue.num_quads = 0; 
+
+        // present is timed too, since that is where most drivers actually do the work 
+        Uint64 start = SDL_GetPerformanceCounter(); 
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+        SDL_RenderClear(renderer); 
+        begin_render_queue(&queue); 
+        render_game(game, &queue, &glyphs); 
+        submit_render_queue(&queue); 
+        SDL_RenderPresent(renderer); 
+        double seconds = (SDL_GetPerformanceCounter() - start) / (double)frequency; 
+
+        if (frame >= 0) {
+            frame_times[frame] = seconds * 1000; 
+            total_time += seconds; 
+        }
+    }
+    unsigned long draws = queue.num_draws, quads = queue.num_quads; 
+
+    qsort(frame_times, num_frames, sizeof(float), compare_floats); 
+    result->p50 = frame_times[num_frames * 50 / 100]; 
+    result->p90 = frame_times[num_frames * 90 / 100]; 
+    result->p99 = frame_times[num_frames * 99 / 100]; 
+    result->max = frame_times[num_frames - 1]; 
+    result->average = total_time * 1000 / num_frames; 
+    result->draws_per_frame = (float)draws / num_frames; 
+    result->draws_per_second = draws / total_time; 
+    result->quads_per_second = quads / total_time; 
+
+    free(frame_times); 
+    SDL_DestroyTexture(game->level_name); 
+    SDL_DestroyTexture(game->map_texture); 
+    SDL_DestroyTexture(game->player.drag_creasent); 
+    SDL_DestroyTexture(game->player.texture); 
+    SDL_DestroyTexture(game->high_res_tiles); 
+    SDL_DestroyTexture(game->low_res_tiles); 
+    free(game); 
+    cleanup_render_queue(&queue); 
+    cleanup_glyphs(&glyphs); 
+    TTF_CloseFont(font); 
+    SDL_DestroyRenderer(renderer); 
+    SDL_DestroyWindow(window); 
+    return 1; 
+}
+
+int main(int argc, char *argv[]) {
+    char *level_path = argc > 1 ? argv[1]: "levels/official/1.lvl"; 
+    int num_frames = argc > 2 ? atoi(argv[2]): 600; 
+    int vsync = argc > 3 && strcmp(argv[3], "vsync") == 0; 
+    if (num_frames < 1) num_frames = 1; 
+
+    FILE *file = fopen(level_path, "rb"); 
+    if (file == NULL) {
+        fprintf(stderr, "could not read %s\n", level_path); 
+        return EXIT_FAILURE; 
+    }
+    fclose(file); 
+
+    SDL_Init(SDL_INIT_VIDEO); 
+    IMG_Init(IMG_INIT_PNG); 
+    TTF_Init(); 
+
+    printf("%d frames of %s, vsync %s\n", num_frames, level_path, vsync? "on": "off"); 
+    printf("%-12s %8s %8s %8s %8s %8s %12s %12s %12s\n", "renderer", "p50 ms", "p90 ms", "p99 ms", "max ms", "avg fps", "draws/frame", "draws/s", "quads/s"); 
+    for (int driver = 0; driver < SDL_GetNumRenderDrivers(); ++driver) {
+        SDL_RendererInfo info; 
+        if (SDL_GetRenderDriverInfo(driver, &info) != 0) continue; 
+
+        struct BenchmarkResult result; 
+        if (!run_benchmark(driver, level_path, num_frames, vsync, &result)) {
+            printf("%-12s not available (%s)\n", info.name, SDL_GetError()); 
+            continue; 
+        }
+        printf("%-12s %8.2f %8.2f %8.2f %8.2f %8.1f %12.1f %12.0f %12.0f\n", info.name, result.p50, result.p90, result.p99, result.max,
+            1000 / result.average, result.draws_per_frame, result.draws_per_second, result.quads_per_second); 
+    }
+    printf("set renderer=<name> in settings.txt (or on the command line) to use one\n"); 
+
+    TTF_Quit(); 
+    IMG_Quit(); 
+    SDL_Quit(); 
+    return EXIT_SUCCESS; 
+}
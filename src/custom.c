@@ -2,6 +2,7 @@
 
 #include <stdio.h> 
 #include <stdlib.h> 
+#include <string.h> 
 #include <dirent.h> 
 #include <SDL_image.h> 
 
@@ -16,7 +17,9 @@ struct CustomSelect {
     struct Button left; 
     struct Button right; 
 
-    struct LevelPreview previews[6]; 
+    // out of the cache shared with the official select (owned by the app) 
+    struct PreviewCache *cache; 
+    struct LevelPreview *previews[6]; 
 
     unsigned page;
 
@@ -30,9 +33,13 @@ struct CustomSelect {
 
     // since the level ids cannot be easily calculated like they can for the official levels, we keep a cache so we only have to calculate them when we need to 
     int ids_cache[6]; 
+
+    // everything above drawn once per page 
+    struct MenuLayer layer; 
 }; 
 
-void get_level_ids(int page, int page_ids[6], int num_custom) {
+// fills page_ids with the ids of num_pages pages starting at first_page, -1 past the last level 
+void get_level_ids(int first_page, int num_pages, int *page_ids, int num_custom) {
     DIR *dir = opendir("levels/custom"); 
 
     int ids[num_custom]; // I usually dont use VLAs, but I will just use it here because it makes it way simpler 
@@ -58,15 +65,15 @@ void get_level_ids(int page, int page_ids[6], int num_custom) {
         ids[j + 1] = val; 
     }
 
-    for (int i = 0; i < 6; ++i) {
-        int level_num = 6 * page + i; 
+    for (int i = 0; i < 6 * num_pages; ++i) {
+        int level_num = 6 * first_page + i; 
         if (level_num < num_custom) page_ids[i] = ids[level_num]; 
         else page_ids[i] = -1; 
     }
 }
 
 
-void init_custom_select(struct CustomSelect *select, SDL_Renderer *renderer, TTF_Font *font, unsigned num_custom) {
+void init_custom_select(struct CustomSelect *select, SDL_Renderer *renderer, TTF_Font *font, struct Assets *assets, struct PreviewCache *cache, unsigned num_custom) {
     // create the permanent buttons that dont change as well as some other basic data 
     init_button(&select->official, 0, 2, 5, "Official", font, renderer); 
     init_button(&select->custom, 0, 9, 5, "Custom", font, renderer); 
@@ -77,95 +84,112 @@ void init_custom_select(struct CustomSelect *select, SDL_Renderer *renderer, TTF
     
     
     // initialize the icons with nearest neighbor to make them smoother
-    init_special_text_button(&select->left, 0, 0, 1, IMG_LoadTexture(renderer, "assets/left.png")); 
-    init_special_text_button(&select->right, 0, UI_W - 1, 1, IMG_LoadTexture(renderer, "assets/right.png")); 
-    SDL_Texture *edit = IMG_LoadTexture(renderer, "assets/edit.png"); 
-    SDL_Texture *delete= IMG_LoadTexture(renderer, "assets/delete.png"); 
+    init_icon_button(&select->left, 0, 0, 1, assets, LeftIcon); 
+    init_icon_button(&select->right, 0, UI_W - 1, 1, assets, RightIcon); 
     for (int i = 0; i < 6; ++i) {
-        init_special_text_button(&select->edits[i], 2 + 6 * (i / 3), 8 * (i % 3), 1, edit);
-        init_special_text_button(&select->deletes[i], 3 + 6 * (i / 3), 8 * (i % 3), 1, delete);
+        init_icon_button(&select->edits[i], 2 + 6 * (i / 3), 8 * (i % 3), 1, assets, EditIcon);
+        init_icon_button(&select->deletes[i], 3 + 6 * (i / 3), 8 * (i % 3), 1, assets, DeleteIcon);
 
     }
     select->page = num_custom / 6; 
+    select->cache = cache; 
+    init_menu_layer(&select->layer, 1); 
 }
 
 void cleanup_custom_select(struct CustomSelect *select) {
-    SDL_DestroyTexture(select->left.text); 
-    SDL_DestroyTexture(select->right.text); 
+    cleanup_menu_layer(&select->layer); 
     SDL_DestroyTexture(select->official.text); 
     SDL_DestroyTexture(select->custom.text); 
     SDL_DestroyTexture(select->new.text); 
-    SDL_DestroyTexture(select->edits[0].text);
-    SDL_DestroyTexture(select->deletes[0].text);
 }
 
-void enter_custom_select(struct CustomSelect *select, SDL_Renderer *renderer, TTF_Font *font, unsigned num_custom) {
-    // get the new level ids for reload 
-    get_level_ids(select->page, select->ids_cache, num_custom); 
+void enter_custom_select(struct CustomSelect *select, unsigned num_custom) {
+    // get the new level ids for reload, with the pages to either side to prefetch 
+    int ids[18]; 
+    int first_page = select->page > 0? select->page - 1: 0; 
+    get_level_ids(first_page, 3, ids, num_custom); 
+    int current = (int)(select->page - first_page) * 6; // where this page's ids start 
+    memcpy(select->ids_cache, ids + current, sizeof(select->ids_cache)); 
 
-    // initialize the previews based on the cached ids 
+    // get the previews based on the cached ids 
     for (int i = 0; i < 6; ++i) {
         unsigned level_num = select->page * 6 + i; 
-        if (level_num < num_custom) { // if it exists, then initialize it (record can be infinity, this is handled by the init function )
-            int level_id = select->ids_cache[i]; // get the level id 
-            char path[32]; 
-            sprintf(path, "levels/custom/%d.lvl", level_id);
+        if (level_num < num_custom) select->previews[i] = get_preview(select->cache, CustomLevel, select->ids_cache[i]); // record can be infinity, the preview handles that 
+        else select->previews[i] = NULL; 
+    }
 
-            init_preview(&select->previews[i], font, renderer, path); 
-        }
-        else { // if it does not exist, set all assets to null 
-            select->previews[i].name = NULL; 
-            select->previews[i].record = NULL; 
-            select->previews[i].map = NULL; 
-        }
+    // then start on the pages to either side, after this page's since the worker goes in order (on the first page the ids go two pages on, 
+    // so the range stops at the next one) 
+    for (int i = current - 6; i < current + 12; ++i) {
+        int on_page = i >= current && i < current + 6; 
+        if (i >= 0 && !on_page && ids[i] != -1) prefetch_preview(select->cache, CustomLevel, ids[i]); 
     }
 
     select->left.enabled = select->page > 0; 
     select->right.enabled = select->page < num_custom/6; 
-}
 
-void render_custom_select(struct CustomSelect *select, SDL_Renderer *renderer, SDL_Texture *tiles, int mouse_row, int mouse_col, unsigned num_custom) {
-    // render buttons using abstracted functions 
-    render_background(renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->official, renderer, tiles, mouse_row, mouse_col);
-    render_button(&select->custom, renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->left, renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->right, renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->new, renderer, tiles, mouse_row, mouse_col); 
+    // layout for hovering and clicks, the layer itself is redrawn on the next render 
+    clear_menu_layer(&select->layer); 
+    add_menu_button(&select->layer, &select->official); 
+    add_menu_button(&select->layer, &select->custom); 
+    add_menu_button(&select->layer, &select->left); 
+    add_menu_button(&select->layer, &select->right); 
+    add_menu_button(&select->layer, &select->new); 
     for (int i = 0; i < 6; ++i) {
         if (select->page * 6 + i < num_custom) {
-            render_button(&select->edits[i], renderer, tiles, mouse_row, mouse_col); 
-            render_button(&select->deletes[i], renderer, tiles, mouse_row, mouse_col); 
-            render_preview(&select->previews[i], i, renderer, tiles, mouse_row, mouse_col, 1); 
+            add_menu_button(&select->layer, &select->edits[i]); 
+            add_menu_button(&select->layer, &select->deletes[i]); 
+            add_menu_preview(&select->layer, i, 1); 
+        }
+    }
+}
+
+void render_custom_select(struct CustomSelect *select, struct RenderQueue *queue, SDL_Texture *tiles, struct Glyphs *glyphs, int mouse_row, int mouse_col, unsigned num_custom) {
+    // render buttons using abstracted functions, into the layer if they changed (with no mouse, the layer draws the hover outline on top) 
+    if (update_preview_cache(select->cache)) select->layer.dirty = 1; // previews that finished loading 
+    if (begin_menu_layer(&select->layer, queue)) {
+        render_background(queue, tiles); 
+        render_button(&select->official, queue, tiles, -1, -1);
+        render_button(&select->custom, queue, tiles, -1, -1); 
+        render_button(&select->left, queue, tiles, -1, -1); 
+        render_button(&select->right, queue, tiles, -1, -1); 
+        render_button(&select->new, queue, tiles, -1, -1); 
+        for (int i = 0; i < 6; ++i) {
+            if (select->page * 6 + i < num_custom) {
+                render_button(&select->edits[i], queue, tiles, -1, -1); 
+                render_button(&select->deletes[i], queue, tiles, -1, -1); 
+                render_preview(select->previews[i], select->cache, i, queue, tiles, glyphs, -1, -1, 1); 
+            }
         }
+        end_menu_layer(&select->layer, queue); 
     }
+    render_menu_layer(&select->layer, queue, mouse_row, mouse_col); 
 }
 
-void handle_custom_event(struct CustomSelect *select, SDL_Event *event, SDL_Renderer *renderer, TTF_Font *font, unsigned *num_custom, enum AppState *next_state, enum LevelType *last_type, unsigned *last_id) {
+void handle_custom_event(struct CustomSelect *select, SDL_Event *event, SDL_Renderer *renderer, unsigned *num_custom, enum AppState *next_state, enum LevelType *last_type, unsigned *last_id) {
     if (event->type == SDL_MOUSEBUTTONDOWN) {
         unsigned mrow, mcol; 
         get_mouse_coords(event->button.x, event->button.y, renderer, &mrow, &mcol); 
+        struct Button *button = get_menu_button(&select->layer, mrow, mcol); 
 
 
         // left and right 
-        if (select->left.enabled && is_mouse_over_button(&select->left, mrow, mcol)) {
+        if (button == &select->left && select->left.enabled) {
             --select->page; 
-            cleanup_previews(select->previews); 
-            enter_custom_select(select, renderer, font, *num_custom); 
+            enter_custom_select(select, *num_custom); 
         }
-        else if (select->right.enabled && is_mouse_over_button(&select->right, mrow, mcol)) {
+        else if (button == &select->right && select->right.enabled) {
             ++select->page; 
-            cleanup_previews(select->previews); 
-            enter_custom_select(select, renderer, font, *num_custom); 
+            enter_custom_select(select, *num_custom); 
         }
 
         // switch to to official 
-        else if (is_mouse_over_button(&select->official, mrow, mcol)) {
+        else if (button == &select->official) {
             *next_state = InOfficial; 
         }
 
         // new level creation 
-        else if (is_mouse_over_button(&select->new, mrow, mcol)) {
+        else if (button == &select->new) {
             // read 
             ++*num_custom; 
             // change num custom in file, change next_id in file, retrieve next_id from file
@@ -219,13 +243,13 @@ void handle_custom_event(struct CustomSelect *select, SDL_Event *event, SDL_Rend
 
 
         for (int i = 0; i < 6; ++i) {
-            if (is_mouse_over_button(&select->edits[i], mrow, mcol) && select->page * 6 + i <= *num_custom) {
+            if (button == &select->edits[i]) {
                 *last_type = CustomLevel; 
                 *last_id = select->ids_cache[i]; 
                 *next_state = InEditor; 
             }
 
-            else if (is_mouse_over_button(&select->deletes[i], mrow, mcol) && select->page * 6 + i <= *num_custom) {
+            else if (button == &select->deletes[i]) {
                 char path[32];
                 sprintf(path, "levels/custom/%d.lvl", select->ids_cache[i]);
                 remove(path); 
@@ -237,8 +261,7 @@ void handle_custom_event(struct CustomSelect *select, SDL_Event *event, SDL_Rend
                 fclose(progress); 
 
 
-                cleanup_previews(select->previews); 
-                enter_custom_select(select, renderer, font, *num_custom); 
+                enter_custom_select(select, *num_custom); 
             }
         }
     }
@@ -5,6 +5,7 @@
 #include <SDL_ttf.h> 
 
 #include "lib.c"
+#include "game.c" // player physics for the trajectory preview
 
 
 void encode_bytes(unsigned bytes, char chars[6]) { // takes in pointer to an unsigned int storing the 4 raw bytes
@@ -32,6 +33,102 @@ void decode_bytes(char chars[6], unsigned *bytes) {
 }
 
 
+// TRAJECTORY PREVIEW 
+// the path the ship would take from the spawn, simulated with the real player physics at a fixed step 
+#define TRAJECTORY_DT (1/120.0)
+#define TRAJECTORY_TICKS 600 // 5 seconds 
+#define TRAJECTORY_BUDGET 0.002 // seconds of simulation per frame, anything left over continues next frame 
+
+struct Trajectory {
+    int thrusters; // both thrusters held the whole time, or no input at all 
+    struct {float x, y, vel_x, vel_y, rot, rot_vel;} states[TRAJECTORY_TICKS + 1]; 
+    unsigned num_valid; // states before this are up to date with the map 
+    int ended; // the ship crashed or won before running out of ticks 
+}; 
+
+void reset_trajectory(struct Trajectory *trajectory, float spawn_x, float spawn_y, float spawn_rot) {
+    trajectory->states[0].x = spawn_x; trajectory->states[0].y = spawn_y; 
+    trajectory->states[0].vel_x = 0; trajectory->states[0].vel_y = 0; 
+    trajectory->states[0].rot = spawn_rot; trajectory->states[0].rot_vel = 0; 
+    trajectory->num_valid = 1; 
+    trajectory->ended = 0; 
+}
+
+int is_trajectory_done(struct Trajectory *trajectory) {
+    return trajectory->ended || trajectory->num_valid == TRAJECTORY_TICKS + 1; 
+}
+
+void step_trajectory(struct Trajectory *trajectory, unsigned char map[MAP_H][MAP_W]) {
+    struct Player player; 
+    unsigned last = trajectory->num_valid - 1; 
+    player.x = trajectory->states[last].x; player.y = trajectory->states[last].y; 
+    player.vel_x = trajectory->states[last].vel_x; player.vel_y = trajectory->states[last].vel_y; 
+    player.rot = trajectory->states[last].rot; player.rot_vel = trajectory->states[last].rot_vel; 
+    player.left_thruster_control = trajectory->thrusters; 
+    player.right_thruster_control = trajectory->thrusters; 
+
+    // same order as update_game: caches, then the state check, then movement 
+    update_player_caches(&player, map); 
+    if (player.collision_cache[Solid] || player.collision_cache[Gravity] || player.collision_cache[AntiGravity] || player.collision_cache[Win]) {
+        trajectory->ended = 1; 
+        return; 
+    }
+    update_player_movement(&player, TRAJECTORY_DT); 
+
+    trajectory->states[trajectory->num_valid].x = player.x; trajectory->states[trajectory->num_valid].y = player.y; 
+    trajectory->states[trajectory->num_valid].vel_x = player.vel_x; trajectory->states[trajectory->num_valid].vel_y = player.vel_y; 
+    trajectory->states[trajectory->num_valid].rot = player.rot; trajectory->states[trajectory->num_valid].rot_vel = player.rot_vel; 
+    ++trajectory->num_valid; 
+}
+
+// throws away everything after the first state that could have been affected by a change to the given cells 
+void invalidate_trajectory(struct Trajectory *trajectory, int min_row, int min_col, int max_row, int max_col) {
+    // gravity reaches 8 tiles, and the collision points are within a tile of the center 
+    float reach = 9; 
+    for (unsigned i = 0; i < trajectory->num_valid; ++i) {
+        float x = trajectory->states[i].x, y = trajectory->states[i].y; 
+        if (min_col - reach <= x && x <= max_col + 1 + reach && min_row - reach <= y && y <= max_row + 1 + reach) {
+            trajectory->num_valid = i + 1; 
+            trajectory->ended = 0; 
+            return; 
+        }
+    }
+}
+
+void render_trajectory(struct Trajectory *trajectory, SDL_Renderer *renderer, float cam_x, float cam_y, float cam_w, float cam_h, int display_w, SDL_Rect viewport) {
+    SDL_Point points[TRAJECTORY_TICKS + 1]; 
+    for (unsigned i = 0; i < trajectory->num_valid; ++i) {
+        points[i].x = (trajectory->states[i].x - cam_x + cam_w/2.0)/cam_w * display_w + 3.25/UI_W * viewport.w; 
+        points[i].y = viewport.h - (trajectory->states[i].y - cam_y + cam_h/2.0)/cam_h * viewport.h; 
+    }
+    SDL_RenderDrawLines(renderer, points, trajectory->num_valid); 
+}
+
+
+
+
+
+
+
+
+
+// MAP CHUNKS 
+// the map is cached in 8x8 tile chunk textures that only get redrawn when the brush touches them 
+// each chunk also keeps smaller copies (each half the size of the last) so zoomed out views do not sample the full tiles 
+#define CHUNK_SIZE 8 
+#define CHUNK_TILE_PX 32 
+#define CHUNK_MIP_LEVELS 4 // 32, 16, 8 and 4 pixels per tile 
+#define CHUNK_ROWS (MAP_H / CHUNK_SIZE)
+#define CHUNK_COLS (MAP_W / CHUNK_SIZE)
+
+
+
+
+
+
+
+
+
 struct Editor {
     // level data 
     char name[32]; 
@@ -47,13 +144,18 @@ struct Editor {
     SDL_Texture *high_res_tiles; 
     SDL_Texture *player; 
 
+    SDL_Texture *chunks[CHUNK_MIP_LEVELS][CHUNK_ROWS][CHUNK_COLS]; 
+    int dirty_chunks[CHUNK_ROWS][CHUNK_COLS]; 
+    SDL_Texture *solid_chunk[CHUNK_MIP_LEVELS]; // everything outside of the map 
+    struct Glow glow; // added over the tiles of the chunks when they are drawn 
+    SDL_Texture *glow_texture; 
+
     // buttons 
     struct Button exit; 
     struct Button play; 
     struct Button import; 
     struct Button export; 
 
-    SDL_Texture *name_texture; 
 
     // tools
     enum Tool {NoneSelected, Rename, Place, Draw} tool; 
@@ -74,50 +176,146 @@ struct Editor {
     // these are shared by the place and draw tools 
     float disp_x, disp_y; // these are normalized from 0-1 on the display 
 
+    // predicted paths from the spawn, shown while placing the spawn or drawing 
+    struct Trajectory coast_trajectory; 
+    struct Trajectory thrust_trajectory; 
+
 }; 
 
+// draws the tiles of one chunk into its textures, tiles outside of the map are drawn as solid 
+void draw_chunk(struct Editor *editor, SDL_Renderer *renderer, SDL_Texture *chunk[CHUNK_MIP_LEVELS], int chunk_row, int chunk_col) {
+    SDL_SetRenderTarget(renderer, chunk[0]); 
+    SDL_RenderClear(renderer); 
+    struct Batch low_batch, high_batch; 
+    init_batch(&low_batch, renderer, editor->low_res_tiles); 
+    init_batch(&high_batch, renderer, editor->high_res_tiles); 
+    for (int i = 0; i < CHUNK_SIZE; ++i) {
+        for (int j = 0; j < CHUNK_SIZE; ++j) {
+            int row = chunk_row * CHUNK_SIZE + i, col = chunk_col * CHUNK_SIZE + j; 
+            unsigned char tile = (row >= 0 && row < MAP_H && col >= 0 && col < MAP_W)? editor->map[row][col]: Solid; 
+            SDL_Rect src = get_tile_src(tile); 
+            batch_quad(is_high_res_tile(tile)? &high_batch: &low_batch, &src, (SDL_FRect){j * CHUNK_TILE_PX, (CHUNK_SIZE - 1 - i) * CHUNK_TILE_PX, CHUNK_TILE_PX, CHUNK_TILE_PX}, BATCH_WHITE); 
+        }
+    }
+    flush_batch(&low_batch); 
+    flush_batch(&high_batch); 
+
+    // then the glow of the chunk's tiles, the solid chunk outside of the map has none 
+    if (chunk_row >= 0) {
+        SDL_Rect glow_src = get_glow_rect(chunk_row * CHUNK_SIZE, chunk_col * CHUNK_SIZE, (chunk_row + 1) * CHUNK_SIZE - 1, (chunk_col + 1) * CHUNK_SIZE - 1); 
+        SDL_RenderCopy(renderer, editor->glow_texture, &glow_src, NULL); 
+    }
+
+    // then each smaller level is the last one shrunk by half with linear filtering 
+    for (int level = 1; level < CHUNK_MIP_LEVELS; ++level) {
+        SDL_SetRenderTarget(renderer, chunk[level]); 
+        SDL_SetTextureScaleMode(chunk[level - 1], SDL_ScaleModeLinear); 
+        SDL_RenderCopy(renderer, chunk[level - 1], NULL, NULL); 
+    }
+}
+
+void mark_all_chunks_dirty(struct Editor *editor) {
+    for (int row = 0; row < CHUNK_ROWS; ++row) {
+        for (int col = 0; col < CHUNK_COLS; ++col) editor->dirty_chunks[row][col] = 1; 
+    }
+}
+
+// redraws the dirty chunks, has to happen while rendering since it needs the renderer 
+void update_chunks(struct Editor *editor, SDL_Renderer *renderer) {
+    // switching targets resets the viewport, so keep the target and the letterboxed viewport to put back after 
+    SDL_Texture *target = SDL_GetRenderTarget(renderer); 
+    SDL_Rect viewport; 
+    SDL_RenderGetViewport(renderer, &viewport); 
+    Uint8 r, g, b, a; // parts of the editor rely on the draw color from the last frame, so keep that too 
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a); 
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+    int any_dirty = 0; 
+    upload_glow(&editor->glow, editor->glow_texture); 
+
+    for (int row = 0; row < CHUNK_ROWS; ++row) {
+        for (int col = 0; col < CHUNK_COLS; ++col) {
+            if (editor->dirty_chunks[row][col]) {
+                SDL_Texture *levels[CHUNK_MIP_LEVELS]; 
+                for (int level = 0; level < CHUNK_MIP_LEVELS; ++level) levels[level] = editor->chunks[level][row][col]; 
+                draw_chunk(editor, renderer, levels, row, col); 
+                editor->dirty_chunks[row][col] = 0; 
+                any_dirty = 1; 
+            }
+        }
+    }
+
+    if (any_dirty) {
+        SDL_SetRenderTarget(renderer, target); 
+        SDL_RenderSetViewport(renderer, &viewport); 
+    }
+    SDL_SetRenderDrawColor(renderer, r, g, b, a); 
+}
+
 // no functinoality yet, lets just get something that displays the buttons with a blank level 
 
-void init_editor(struct Editor *editor, SDL_Renderer *renderer, TTF_Font *font) {
-    editor->low_res_tiles = IMG_LoadTexture(renderer, "assets/low_res_tiles.png"); 
-    editor->high_res_tiles = IMG_LoadTexture(renderer, "assets/high_res_tiles.png"); 
-    editor->player = IMG_LoadTexture(renderer, "assets/space_ship.png"); 
+void init_editor(struct Editor *editor, SDL_Renderer *renderer, TTF_Font *font, struct Assets *assets) {
+    // shared with the game and the menus 
+    editor->low_res_tiles = load_asset(assets, renderer, "assets/low_res_tiles.png"); 
+    editor->high_res_tiles = load_asset(assets, renderer, "assets/high_res_tiles.png"); 
+    editor->player = load_asset(assets, renderer, "assets/space_ship.png"); 
+
+    // the high res tiles get shrunk into the chunks, so filter them 
+    SDL_SetTextureScaleMode(editor->high_res_tiles, SDL_ScaleModeLinear); 
+    init_glow(&editor->glow); 
+    editor->glow_texture = create_glow_texture(renderer); 
+    for (int level = 0; level < CHUNK_MIP_LEVELS; ++level) {
+        int size = CHUNK_SIZE * (CHUNK_TILE_PX >> level); 
+        for (int row = 0; row < CHUNK_ROWS; ++row) {
+            for (int col = 0; col < CHUNK_COLS; ++col) {
+                editor->chunks[level][row][col] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, size, size); 
+            }
+        }
+        editor->solid_chunk[level] = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, size, size); 
+    }
+    SDL_Texture *target = SDL_GetRenderTarget(renderer); 
+    SDL_Rect viewport; 
+    SDL_RenderGetViewport(renderer, &viewport); 
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+    draw_chunk(editor, renderer, editor->solid_chunk, -1, -1); 
+    SDL_SetRenderTarget(renderer, target); 
+    SDL_RenderSetViewport(renderer, &viewport); 
 
     // just buttons
-    init_special_text_button(&editor->exit, 0, 0, 1, IMG_LoadTexture(renderer, "assets/exit.png")); 
-    init_special_text_button(&editor->play, 0, 2, 1, IMG_LoadTexture(renderer, "assets/play.png")); 
-    init_special_text_button(&editor->import, 1, 0, 1, IMG_LoadTexture(renderer, "assets/import.png")); 
-    init_special_text_button(&editor->export, 1, 2, 1, IMG_LoadTexture(renderer, "assets/export.png")); 
+    init_icon_button(&editor->exit, 0, 0, 1, assets, ExitIcon); 
+    init_icon_button(&editor->play, 0, 2, 1, assets, PlayIcon); 
+    init_icon_button(&editor->import, 1, 0, 1, assets, ImportIcon); 
+    init_icon_button(&editor->export, 1, 2, 1, assets, ExportIcon); 
 
-    init_special_text_button(&editor->rename, 3, 0, 1, IMG_LoadTexture(renderer, "assets/rename.png")); 
+    init_icon_button(&editor->rename, 3, 0, 1, assets, RenameIcon); 
 
-    init_special_text_button(&editor->place_spawn, 3, 1, 1, IMG_LoadTexture(renderer, "assets/place_spawn.png")); 
-    init_special_text_button(&editor->rotate_spawn, 5, 0, 1, IMG_LoadTexture(renderer, "assets/rotate_spawn.png")); 
+    init_icon_button(&editor->place_spawn, 3, 1, 1, assets, PlaceSpawnIcon); 
+    init_icon_button(&editor->rotate_spawn, 5, 0, 1, assets, RotateSpawnIcon); 
 
-    init_special_text_button(&editor->draw, 3, 2, 1, IMG_LoadTexture(renderer, "assets/edit.png")); 
+    init_icon_button(&editor->draw, 3, 2, 1, assets, EditIcon); 
 
     init_button(&editor->larger, 12, 0, 1, "+",  font, renderer); 
     init_button(&editor->smaller, 12, 2, 1, "-",  font, renderer); 
 }
 
-void cleanup_editor(struct Editor *editor) {
+void cleanup_editor(struct Editor *editor, struct Assets *assets) {
     SDL_DestroyTexture(editor->smaller.text); 
     SDL_DestroyTexture(editor->larger.text); 
-    SDL_DestroyTexture(editor->draw.text); 
-    SDL_DestroyTexture(editor->rotate_spawn.text); 
-    SDL_DestroyTexture(editor->place_spawn.text); 
-    SDL_DestroyTexture(editor->rename.text); 
-    SDL_DestroyTexture(editor->export.text); 
-    SDL_DestroyTexture(editor->import.text); 
-    SDL_DestroyTexture(editor->play.text); 
-    SDL_DestroyTexture(editor->exit.text); 
-
-    SDL_DestroyTexture(editor->high_res_tiles); 
-    SDL_DestroyTexture(editor->low_res_tiles); 
-    SDL_DestroyTexture(editor->player); 
+
+    SDL_DestroyTexture(editor->glow_texture); 
+    cleanup_glow(&editor->glow); 
+    for (int level = 0; level < CHUNK_MIP_LEVELS; ++level) {
+        SDL_DestroyTexture(editor->solid_chunk[level]); 
+        for (int row = 0; row < CHUNK_ROWS; ++row) {
+            for (int col = 0; col < CHUNK_COLS; ++col) SDL_DestroyTexture(editor->chunks[level][row][col]); 
+        }
+    }
+
+    release_asset(assets, editor->high_res_tiles); 
+    release_asset(assets, editor->low_res_tiles); 
+    release_asset(assets, editor->player); 
 }
 
-void enter_editor_state(struct Editor *editor, SDL_Renderer *renderer, TTF_Font *font, char *level_path) {
+void enter_editor_state(struct Editor *editor, char *level_path) {
     // read out of the file path 
     FILE *file = fopen(level_path, "rb"); 
     fread(editor->name, sizeof(editor->name), 1, file); 
@@ -132,8 +330,6 @@ void enter_editor_state(struct Editor *editor, SDL_Renderer *renderer, TTF_Font
     editor->cam_y = MAP_H/2.0; 
     editor->cam_w = 60; 
 
-    init_text(&editor->name_texture, editor->name, font, (SDL_Color){0, 180, 180, 255}, renderer); 
-
     editor->tool = NoneSelected; 
     editor->selected = Solid; 
     editor->size = 1; 
@@ -148,11 +344,17 @@ void enter_editor_state(struct Editor *editor, SDL_Renderer *renderer, TTF_Font
     editor->rename.enabled = 1; 
     editor->draw.enabled = 1; 
 
+    mark_all_chunks_dirty(editor); 
+    bake_glow(&editor->glow, editor->map); 
+
+    editor->coast_trajectory.thrusters = 0; 
+    editor->thrust_trajectory.thrusters = 1; 
+    reset_trajectory(&editor->coast_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
+    reset_trajectory(&editor->thrust_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
 
 }
 
 void exit_editor_state(struct Editor *editor, char *level_path) {
-    SDL_DestroyTexture(editor->name_texture);
     
     unsigned char old_map[MAP_H][MAP_W]; 
     float old_spawn_x, old_spawn_y, old_spawn_rot; 
@@ -190,29 +392,65 @@ void exit_editor_state(struct Editor *editor, char *level_path) {
 
 // fix this whole tile inconsistancy thing, figure out a better system of ownership 
 // I need consistant abstractions shared between different parts of the program, so get on that once this is done 
-void render_editor(struct Editor *editor, SDL_Renderer *renderer, SDL_Texture *tiles, int mr, int mc) {
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
+void render_editor(struct Editor *editor, struct RenderQueue *queue, SDL_Texture *tiles, struct Glyphs *glyphs, int mr, int mc) {
+    SDL_Renderer *renderer = queue->renderer; 
+    SDL_Rect viewport = queue->viewport; 
 
     float cam_h = editor->cam_w * UI_H/(UI_W - 3.25); 
     int display_w = (UI_W - 3.25)/UI_W * viewport.w; 
 
-    SDL_RenderGetViewport(renderer, &viewport); 
-    for (int row = floorf(editor->cam_y - cam_h/2.0); row <= floorf(editor->cam_y + cam_h/2.0); ++row) {
-        for (int col = floorf(editor->cam_x - editor->cam_w/2.0); col <= floorf(editor->cam_x + editor->cam_w/2.0); ++col) {
-            
-            int screen_x = (col - editor->cam_x + editor->cam_w/2.0)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
-            int screen_y = viewport.h - (row - editor->cam_y + cam_h/2.0 + 1)/cam_h * viewport.h; 
-
-            int tile_res = (row >= 0 && row < MAP_H && col >= 0 && col < MAP_W && (editor->map[row][col] >= DownForce && editor->map[row][col] <= ClockwiseTorque))? 64: 16; 
-            int tile_offset = tile_res == 64? (editor->map[row][col] - 11) * 64 : row >= 0 && row < MAP_H && col >= 0 && col < MAP_W? editor->map[row][col] * 16: 16; 
-            SDL_RenderCopy(renderer, tile_res == 64? editor->high_res_tiles: editor->low_res_tiles, &(SDL_Rect){tile_offset, 0, tile_res, tile_res}, &(SDL_Rect){screen_x, screen_y, display_w/editor->cam_w + 1, viewport.h/cam_h + 1});  // add one to dimensions to cover up disconnects 
+    // map chunks, a few dozen copies at most no matter the zoom. They and the trajectories are drawn straight away, so under everything queued 
+    update_chunks(editor, renderer); 
+
+    // use the smallest level that still has at least as many pixels per tile as the screen, filtering only when it is shrunk 
+    float screen_tile_px = display_w / editor->cam_w; 
+    int level = 0; 
+    while (level + 1 < CHUNK_MIP_LEVELS && (CHUNK_TILE_PX >> (level + 1)) >= screen_tile_px) ++level; 
+    SDL_ScaleMode scale_mode = screen_tile_px < (CHUNK_TILE_PX >> level)? SDL_ScaleModeLinear: SDL_ScaleModeNearest; 
+
+    for (int chunk_row = floorf((editor->cam_y - cam_h/2.0) / CHUNK_SIZE); chunk_row <= floorf((editor->cam_y + cam_h/2.0) / CHUNK_SIZE); ++chunk_row) {
+        for (int chunk_col = floorf((editor->cam_x - editor->cam_w/2.0) / CHUNK_SIZE); chunk_col <= floorf((editor->cam_x + editor->cam_w/2.0) / CHUNK_SIZE); ++chunk_col) {
+            // both edges are computed the same way for every chunk so neighbours always meet exactly 
+            int left = (chunk_col * CHUNK_SIZE - editor->cam_x + editor->cam_w/2.0)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
+            int right = ((chunk_col + 1) * CHUNK_SIZE - editor->cam_x + editor->cam_w/2.0)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
+            int top = viewport.h - ((chunk_row + 1) * CHUNK_SIZE - editor->cam_y + cam_h/2.0)/cam_h * viewport.h; 
+            int bottom = viewport.h - (chunk_row * CHUNK_SIZE - editor->cam_y + cam_h/2.0)/cam_h * viewport.h; 
+
+            int in_map = chunk_row >= 0 && chunk_row < CHUNK_ROWS && chunk_col >= 0 && chunk_col < CHUNK_COLS; 
+            SDL_Texture *chunk = in_map? editor->chunks[level][chunk_row][chunk_col]: editor->solid_chunk[level]; 
+            SDL_SetTextureScaleMode(chunk, scale_mode); 
+            SDL_RenderCopy(renderer, chunk, NULL, &(SDL_Rect){left, top, right - left, bottom - top}); 
         }
     }
+    // the glow reaches GLOW_RADIUS tiles onto the walls around the map like in the game, the chunks out there are all one texture, so the ring of 
+    // the glow outside the map is drawn over them here (as the rows below and above the map, then the columns either side of it) 
+    int glow_ranges[4][4] = {
+        {-GLOW_RADIUS, -GLOW_RADIUS, -1, MAP_W + GLOW_RADIUS - 1}, {MAP_H, -GLOW_RADIUS, MAP_H + GLOW_RADIUS - 1, MAP_W + GLOW_RADIUS - 1}, 
+        {0, -GLOW_RADIUS, MAP_H - 1, -1}, {0, MAP_W, MAP_H - 1, MAP_W + GLOW_RADIUS - 1}
+    }; 
+    for (int i = 0; i < 4; ++i) {
+        int row0 = glow_ranges[i][0], col0 = glow_ranges[i][1], row1 = glow_ranges[i][2], col1 = glow_ranges[i][3]; 
+        SDL_Rect glow_src = get_glow_rect(row0, col0, row1, col1); 
+        int left = (col0 - editor->cam_x + editor->cam_w/2.0)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
+        int right = (col1 + 1 - editor->cam_x + editor->cam_w/2.0)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
+        int top = viewport.h - (row1 + 1 - editor->cam_y + cam_h/2.0)/cam_h * viewport.h; 
+        int bottom = viewport.h - (row0 - editor->cam_y + cam_h/2.0)/cam_h * viewport.h; 
+        SDL_RenderCopy(renderer, editor->glow_texture, &glow_src, &(SDL_Rect){left, top, right - left, bottom - top}); 
+    }
+    // trajectories 
+    if (editor->tool == Place || editor->tool == Draw) {
+        SDL_SetRenderDrawColor(renderer, 180, 180, 180, 255); 
+        render_trajectory(&editor->coast_trajectory, renderer, editor->cam_x, editor->cam_y, editor->cam_w, cam_h, display_w, viewport); 
+        SDL_SetRenderDrawColor(renderer, 0, 180, 0, 255); 
+        render_trajectory(&editor->thrust_trajectory, renderer, editor->cam_x, editor->cam_y, editor->cam_w, cam_h, display_w, viewport); 
+    }
+
     // player 
     int screen_x = (editor->spawn_x - editor->cam_x + editor->cam_w/2.0 - 0.125)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
     int screen_y = viewport.h - (editor->spawn_y - editor->cam_y + cam_h/2.0 - 0.25 + 0.5)/cam_h * viewport.h; 
-    SDL_RenderCopyEx(renderer, editor->player, NULL, &(SDL_Rect){screen_x, screen_y, 0.5/editor->cam_w * display_w, 0.5/cam_h * viewport.h}, editor->spawn_rot * -180/M_PI, &(SDL_Point){0.125/editor->cam_w * display_w, 0.25/cam_h * viewport.h}, SDL_FLIP_NONE); 
+    SDL_FRect player_dst = {screen_x, screen_y, (int)(0.5/editor->cam_w * display_w), (int)(0.5/cam_h * viewport.h)}; 
+    SDL_FPoint player_center = {(int)(0.125/editor->cam_w * display_w), (int)(0.25/cam_h * viewport.h)}; 
+    queue_rotated_quad(queue, SpriteLayer, editor->player, NULL, player_dst, editor->spawn_rot * -180/M_PI, player_center, BATCH_WHITE); 
     
     // drawing outline 
     if (editor->tool == Draw) {
@@ -235,15 +473,14 @@ void render_editor(struct Editor *editor, SDL_Renderer *renderer, SDL_Texture *t
 
             int thickness = 0.05/UI_W * viewport.w; // just use the same thickness as on buttons, regardless of the camera zoom 
 
-
             // left
-            SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y, thickness, p_height}); 
+            queue_fill_rect(queue, EffectLayer, (SDL_Rect){p_x, p_y, thickness, p_height}, MENU_CYAN); 
             // right
-            SDL_RenderFillRect(renderer, &(SDL_Rect){p_x + p_width - thickness, p_y, thickness, p_height}); 
+            queue_fill_rect(queue, EffectLayer, (SDL_Rect){p_x + p_width - thickness, p_y, thickness, p_height}, MENU_CYAN); 
             // top 
-            SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y, p_width, thickness}); 
+            queue_fill_rect(queue, EffectLayer, (SDL_Rect){p_x, p_y, p_width, thickness}, MENU_CYAN); 
             // bottom 
-            SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y + p_height - thickness, p_width, thickness}); 
+            queue_fill_rect(queue, EffectLayer, (SDL_Rect){p_x, p_y + p_height - thickness, p_width, thickness}, MENU_CYAN); 
         }
     }
 
@@ -257,70 +494,70 @@ void render_editor(struct Editor *editor, SDL_Renderer *renderer, SDL_Texture *t
         if (0 < map_x && map_x < MAP_W && 0 < map_y && map_y < MAP_H) {
             int screen_x = (map_x - editor->cam_x + editor->cam_w/2.0 - 0.125)/editor->cam_w * display_w + 3.25/UI_W * viewport.w; 
             int screen_y = viewport.h - (map_y - editor->cam_y + cam_h/2.0 - 0.25 + 0.5)/cam_h * viewport.h; 
-            SDL_SetTextureAlphaMod(editor->player, 128);
-            SDL_RenderCopyEx(renderer, editor->player, NULL, &(SDL_Rect){screen_x, screen_y, 0.5/editor->cam_w * display_w, 0.5/cam_h * viewport.h}, editor->spawn_rot * -180/M_PI, &(SDL_Point){0.125/editor->cam_w * display_w, 0.25/cam_h * viewport.h}, SDL_FLIP_NONE);
-            SDL_SetTextureAlphaMod(editor->player, 255);
+            SDL_FRect shadow_dst = {screen_x, screen_y, player_dst.w, player_dst.h}; 
+            queue_rotated_quad(queue, SpriteLayer, editor->player, NULL, shadow_dst, editor->spawn_rot * -180/M_PI, player_center, (SDL_Color){255, 255, 255, 128}); 
         }
 
     }
 
     else if (editor->tool == Rename) {
-        render_menu_outline(renderer, 0, 4, 5, 1); 
+        render_menu_outline(queue, 0, 4, 5, 1, MENU_CYAN); 
     }
 
+    // the tool bar covers anything in the map that is under it, so the map side goes out first 
+    submit_render_queue(queue); 
+
     // tool bar background 
     for (int row = 0; row < UI_H; ++row) {
         for (int col = 0; col < 3; ++col) {
-            render_menu_tile(renderer, tiles, Blank, row, col); 
+            render_menu_tile(queue, tiles, Blank, row, col); 
         }
     }   
     // buttons 
-    render_button(&editor->exit, renderer, tiles, mr, mc); 
-    render_button(&editor->play, renderer, tiles, mr, mc); 
-    render_button(&editor->import, renderer, tiles, mr, mc); 
-    render_button(&editor->export, renderer, tiles, mr, mc); 
+    render_button(&editor->exit, queue, tiles, mr, mc); 
+    render_button(&editor->play, queue, tiles, mr, mc); 
+    render_button(&editor->import, queue, tiles, mr, mc); 
+    render_button(&editor->export, queue, tiles, mr, mc); 
     
 
     // tools 
-    render_button(&editor->rename, renderer, tiles, mr, mc); 
-    render_button(&editor->place_spawn, renderer, tiles, mr, mc); 
-    render_button(&editor->draw, renderer, tiles, mr, mc); 
+    render_button(&editor->rename, queue, tiles, mr, mc); 
+    render_button(&editor->place_spawn, queue, tiles, mr, mc); 
+    render_button(&editor->draw, queue, tiles, mr, mc); 
 
     if (editor->tool == Place) {
-        render_button(&editor->rotate_spawn, renderer, tiles, mr, mc); 
+        render_button(&editor->rotate_spawn, queue, tiles, mr, mc); 
     }
     else if (editor->tool == Draw) {
-        render_button(&editor->larger, renderer, tiles, mr, mc); 
-        render_button(&editor->smaller, renderer, tiles, mr, mc); 
+        render_button(&editor->larger, queue, tiles, mr, mc); 
+        render_button(&editor->smaller, queue, tiles, mr, mc); 
 
         for (int row = 5; row < 11; ++row) {
             for (int col = 0; col < 3; ++col) {
                 int tile = (row - 5) * 3 + col; 
-                int tile_res = tile >= DownForce? 64 : 16;  
-                int tile_offset = tile_res == 64? (tile - 11) * 64: tile * 16; 
-                SDL_RenderCopy(renderer, tile_res == 64? editor->high_res_tiles: editor->low_res_tiles, &(SDL_Rect){tile_offset, 0, tile_res, tile_res},  &(SDL_Rect){(float)col/UI_W * viewport.w, (float)row/UI_H * viewport.h, 1.0/UI_W * viewport.w + 1, 1.0/UI_H * viewport.h + 1}); 
+                if (tile > ClockwiseTorque) continue; // the last cell of the grid is empty 
+                SDL_Rect src = get_tile_src(tile); 
+                SDL_Rect dst = {(float)col/UI_W * viewport.w, (float)row/UI_H * viewport.h, 1.0/UI_W * viewport.w + 1, 1.0/UI_H * viewport.h + 1}; 
+                queue_quad(queue, SpriteLayer, is_high_res_tile(tile)? editor->high_res_tiles: editor->low_res_tiles, &src, (SDL_FRect){dst.x, dst.y, dst.w, dst.h}, BATCH_WHITE); 
             }
         }
 
         int row = editor->selected/ 3 + 5; 
         int col = editor->selected % 3; 
-        SDL_SetRenderDrawColor(renderer,180, 180, 180, 255); 
-        render_menu_outline(renderer, row, col, 1, 1); 
+        render_menu_outline(queue, row, col, 1, 1, (SDL_Color){180, 180, 180, 255}); 
 
 
         if (editor->tool == Draw && 5 <= mr && mr <= 10 && mc <= 2 && !(mr == 10 && mc == 2)) { 
-            SDL_SetRenderDrawColor(renderer, 0, 180, 180, 255); 
-            render_menu_outline(renderer, mr, mc, 1, 1); 
+            render_menu_outline(queue, mr, mc, 1, 1, MENU_CYAN); 
         }
 
     }
 
     // seperator 
-    SDL_SetRenderDrawColor(renderer, 0, 180 , 180, 255); 
-    SDL_RenderFillRect(renderer, &(SDL_Rect){3.0/UI_W * viewport.w, 0, 0.25/UI_W * viewport.w, viewport.h}); 
+    queue_fill_rect(queue, GroundLayer, (SDL_Rect){3.0/UI_W * viewport.w, 0, 0.25/UI_W * viewport.w, viewport.h}, MENU_CYAN); 
 
     // name 
-    render_menu_text(renderer, editor->name_texture, 0, 4, 0.75, Left); 
+    render_glyph_text(queue, glyphs, editor->name, (SDL_Color){0, 180, 180, 255}, 0, 4, 0.75, Left); 
 
 
    
@@ -328,6 +565,12 @@ void render_editor(struct Editor *editor, SDL_Renderer *renderer, SDL_Texture *t
 
 
 
+}
+
+// the editor only changes on input, except while painting or while the trajectories are still being simulated 
+int editor_needs_frames(struct Editor *editor) {
+    if (editor->tool == Draw && editor->brush_down) return 1; 
+    return (editor->tool == Place || editor->tool == Draw) && !(is_trajectory_done(&editor->coast_trajectory) && is_trajectory_done(&editor->thrust_trajectory)); 
 }
 
 void update_editor(struct Editor *editor) {
@@ -342,17 +585,53 @@ void update_editor(struct Editor *editor) {
             int row = roundf(map_y - editor->size/2.0); 
             int col = roundf(map_x - editor->size/2.0); 
 
+            // the cells that actually changed, collected over the whole brush so the glow is blurred again once for all of them 
+            int changed = 0; 
+            int row0 = MAP_H, col0 = MAP_W, row1 = -1, col1 = -1; 
             for (int i = row; i < row + (int)editor->size; ++i) {
                 for (int j = col; j < col + (int)editor->size; ++j) {
-                    if (0 <= i && i < MAP_H && 0 <= j && j < MAP_W) editor->map[i][j] = editor->selected; 
+                    if (0 <= i && i < MAP_H && 0 <= j && j < MAP_W && editor->map[i][j] != editor->selected) {
+                        editor->map[i][j] = editor->selected; 
+                        editor->dirty_chunks[i / CHUNK_SIZE][j / CHUNK_SIZE] = 1; 
+                        changed = 1; 
+                        if (i < row0) row0 = i; 
+                        if (i > row1) row1 = i; 
+                        if (j < col0) col0 = j; 
+                        if (j > col1) col1 = j; 
+                    }
+                }
+            }
+
+            // the light of the painted tiles reaches past the brush, so the chunks it reaches are drawn again too 
+            if (changed && update_glow(&editor->glow, editor->map, row0, col0, row1, col1)) {
+                for (int i = (row0 - GLOW_RADIUS > 0? row0 - GLOW_RADIUS: 0) / CHUNK_SIZE; i <= (row1 + GLOW_RADIUS < MAP_H? row1 + GLOW_RADIUS: MAP_H - 1) / CHUNK_SIZE; ++i) {
+                    for (int j = (col0 - GLOW_RADIUS > 0? col0 - GLOW_RADIUS: 0) / CHUNK_SIZE; j <= (col1 + GLOW_RADIUS < MAP_W? col1 + GLOW_RADIUS: MAP_W - 1) / CHUNK_SIZE; ++j) editor->dirty_chunks[i][j] = 1; 
                 }
             }
+
+            // only the part of the paths after they got near the brush needs to be simulated again 
+            if (changed) {
+                invalidate_trajectory(&editor->coast_trajectory, row, col, row + (int)editor->size - 1, col + (int)editor->size - 1); 
+                invalidate_trajectory(&editor->thrust_trajectory, row, col, row + (int)editor->size - 1, col + (int)editor->size - 1); 
+            }
+        }
+    }
+
+    // continue the trajectories for as long as the frame budget allows 
+    if (editor->tool == Place || editor->tool == Draw) {
+        Uint64 start = SDL_GetPerformanceCounter(); 
+        Uint64 budget = TRAJECTORY_BUDGET * SDL_GetPerformanceFrequency(); 
+        while (!(is_trajectory_done(&editor->coast_trajectory) && is_trajectory_done(&editor->thrust_trajectory)) && SDL_GetPerformanceCounter() - start < budget) {
+            // a few steps between each time check 
+            for (int i = 0; i < 8; ++i) {
+                if (!is_trajectory_done(&editor->coast_trajectory)) step_trajectory(&editor->coast_trajectory, editor->map); 
+                if (!is_trajectory_done(&editor->thrust_trajectory)) step_trajectory(&editor->thrust_trajectory, editor->map); 
+            }
         }
     }
-    
 }
 
-void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *renderer, TTF_Font *font, enum AppState *next_state) {
+void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *renderer, struct Glyphs *glyphs, enum AppState *next_state) {
     // buttons 
     if (event->type == SDL_MOUSEBUTTONDOWN) {
         unsigned mrow, mcol; 
@@ -391,7 +670,11 @@ void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *
             if (editor->size < 6) editor->larger.enabled = 1; 
         } 
 
-        else if (editor->tool == Place && is_mouse_over_button(&editor->rotate_spawn, mrow, mcol)) editor->spawn_rot -= M_PI/4; 
+        else if (editor->tool == Place && is_mouse_over_button(&editor->rotate_spawn, mrow, mcol)) {
+            editor->spawn_rot -= M_PI/4; 
+            reset_trajectory(&editor->coast_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
+            reset_trajectory(&editor->thrust_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
+        }
 
 
         else if (is_mouse_over_button(&editor->export, mrow, mcol)) {
@@ -437,6 +720,11 @@ void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *
                         editor->map[row][col] = import[32 + 6 + 6 + 6 + row * MAP_W + col] - 'a'; 
                     }
                 }
+
+                mark_all_chunks_dirty(editor); 
+                bake_glow(&editor->glow, editor->map); 
+                reset_trajectory(&editor->coast_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
+                reset_trajectory(&editor->thrust_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
             }
             
         }
@@ -492,6 +780,8 @@ void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *
         if (0 < map_x && map_x < MAP_W && 0 < map_y && map_y < MAP_H  && (event->button.x > viewport.w * 3.125/UI_W)) {
             editor->spawn_x = map_x; 
             editor->spawn_y = map_y; 
+            reset_trajectory(&editor->coast_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
+            reset_trajectory(&editor->thrust_trajectory, editor->spawn_x, editor->spawn_y, editor->spawn_rot); 
         } 
     }
 
@@ -503,22 +793,10 @@ void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *
             editor->name[len] = event->text.text[0]; 
             editor->name[len + 1] = '\0'; 
 
-            // create the texture to test if it can be done 
+            // lets see if new name is wider than 5 menu tiles, measured from the glyph metrics 
+            float ui_width = 0.75 * measure_glyph_text(glyphs, editor->name) / glyphs->line_h; // displayed at 0.75 height 
 
-            SDL_Texture *new_name; 
-            init_text(&new_name, editor->name, font, (SDL_Color){0, 180, 180, 255}, renderer);
-
-            // lets see if new name is wider than 5 menu tiles 
-            int tw, th; 
-            SDL_QueryTexture(new_name, NULL, NULL, &tw, &th); 
-            float ui_width = 0.75 * tw/th; // displayed at 0.75 height 
-
-            if (ui_width < 5) {
-                SDL_DestroyTexture(editor->name_texture); 
-                editor->name_texture = new_name; 
-            }
-            else { // does not fit, destroy test and return string to prior state
-                SDL_DestroyTexture(new_name); 
+            if (ui_width >= 5) { // does not fit, return string to prior state
                 editor->name[len] = '\0'; 
             }
         }
@@ -528,8 +806,6 @@ void handle_editor_event(struct Editor *editor, SDL_Event *event, SDL_Renderer *
         unsigned len = strlen(editor->name); 
         if (len > 0) {
             editor->name[len - 1] = '\0';
-            SDL_DestroyTexture(editor->name_texture); 
-            init_text(&editor->name_texture, editor->name, font, (SDL_Color){0, 180, 180, 255}, renderer); 
         }
     }
 }
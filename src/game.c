@@ -5,6 +5,11 @@
 #include <SDL_mixer.h> 
 
 #include "lib.c"
+#include "telemetry.c"
+#include "replay.c"
+
+#ifndef GAME_C
+#define GAME_C 
 
 // sound channels 
 #define LEFT_THRUSTER_CHANNEL 0
@@ -18,45 +23,208 @@
 #define CAM_W 12.0
 #define CAM_H 6.75
 
+// the static map is drawn once per attempt into one texture, with a border of solid tiles so the camera never looks off of it. It is baked at the 
+// high res tiles' own 64 px so the force and torque tiles keep their detail (3968x2944), or at half that if the renderer's textures can't be that big 
+#define MAP_TEXTURE_TILE_PX 64 
+#define MAP_TEXTURE_SMALL_TILE_PX 32 
+#define MAP_TEXTURE_BORDER 7 // half the camera width plus one 
+
+
+// particle system 
+// all of the player's particles share one structure of arrays, split into a fixed range per emitter. The live particles of an emitter are always 
+// packed at the start of its range (a dead one is swapped with the last live one), so updating and drawing only ever touch live particles and the 
+// movement loop has no branches at all. It is a plain value with no pointers, so the replay keyframes can still copy the player whole 
+#define MAX_PARTICLES 1024 
+
+enum Emitter {ThrusterEmitter, ForceEmitter, ExplosionEmitter, NUM_EMITTERS}; 
 
-// particle system
-struct Particle {
-    float x, y; 
-    float x_vel, y_vel; 
-    float size; 
+struct Particles {
+    float x[MAX_PARTICLES], y[MAX_PARTICLES]; 
+    float x_vel[MAX_PARTICLES], y_vel[MAX_PARTICLES]; 
+    float size[MAX_PARTICLES]; 
+
+    unsigned start[NUM_EMITTERS]; 
+    unsigned capacity[NUM_EMITTERS]; 
+    unsigned count[NUM_EMITTERS]; // live particles, from start 
 }; 
 
-void update_particles(struct Particle particles[], unsigned num_particles, float delta_time, float life_time, unsigned char map[MAP_H][MAP_W]) {
-    for (int i = 0; i < num_particles; ++i) {
-        if (particles[i].size > 0) {
-            particles[i].x += particles[i].x_vel * delta_time; 
-            particles[i].y += particles[i].y_vel * delta_time; 
-            particles[i].size -= 1/life_time * delta_time; 
-            // if the updated position is inside of something, then it should be gone 
-            if (0 > particles[i].x || particles[i].x >= MAP_W || 0 > particles[i].y || particles[i].y >= MAP_H || map[(int)floorf(particles[i].y)][(int)floorf(particles[i].x)] == Solid || map[(int)floorf(particles[i].y)][(int)floorf(particles[i].x)] == Gravity || map[(int)floorf(particles[i].y)][(int)floorf(particles[i].x)] == AntiGravity) particles[i].size = 0; 
+void init_particles(struct Particles *particles) {
+    // thrusters and force tiles emit steadily and only need a little room, the explosion is one burst that gets the rest 
+    unsigned capacities[NUM_EMITTERS] = {128, 64, MAX_PARTICLES - 128 - 64}; 
+    unsigned start = 0; 
+    for (int emitter = 0; emitter < NUM_EMITTERS; ++emitter) {
+        particles->start[emitter] = start; 
+        particles->capacity[emitter] = capacities[emitter]; 
+        particles->count[emitter] = 0; 
+        start += capacities[emitter]; 
+    }
+}
+
+// when the emitter is full the new particle is dropped, the capacities are well over what the emission rates can keep alive 
+void emit_particle(struct Particles *particles, enum Emitter emitter, float x, float y, float x_vel, float y_vel, float size) {
+    if (particles->count[emitter] == particles->capacity[emitter]) return; 
+    unsigned i = particles->start[emitter] + particles->count[emitter]++; 
+    particles->x[i] = x; particles->y[i] = y; 
+    particles->x_vel[i] = x_vel; particles->y_vel[i] = y_vel; 
+    particles->size[i] = size; 
+}
+
+// tiles a particle disappears into 
+int stops_particles(unsigned char tile) {
+    return tile == Solid || tile == Gravity || tile == AntiGravity; 
+}
+
+void update_particles(struct Particles *particles, enum Emitter emitter, float delta_time, float life_time, unsigned char map[MAP_H][MAP_W]) {
+    unsigned start = particles->start[emitter], end = start + particles->count[emitter]; 
+    float *x = particles->x, *y = particles->y, *size = particles->size; 
+
+    // straight through every live particle, which the compiler can vectorize 
+    float shrink = 1/life_time * delta_time; 
+    for (unsigned i = start; i < end; ++i) {
+        x[i] += particles->x_vel[i] * delta_time; 
+        y[i] += particles->y_vel[i] * delta_time; 
+        size[i] -= shrink; 
+    }
+
+    // then remove the ones that are gone or inside of something, backwards so a swapped in particle has already been checked 
+    for (unsigned i = end; i-- > start; ) {
+        int dead = size[i] <= 0 || 0 > x[i] || x[i] >= MAP_W || 0 > y[i] || y[i] >= MAP_H || stops_particles(map[(int)floorf(y[i])][(int)floorf(x[i])]); 
+        if (dead) {
+            unsigned last = start + --particles->count[emitter]; 
+            x[i] = x[last]; y[i] = y[last]; 
+            particles->x_vel[i] = particles->x_vel[last]; particles->y_vel[i] = particles->y_vel[last]; 
+            size[i] = size[last]; 
         }
     }
 }
 
-void render_particles(SDL_Renderer *renderer, struct Particle particles[], unsigned num_particles, float player_x, float player_y) {
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
-    SDL_SetRenderDrawColor(renderer, 123, 226 , 237, 255); 
-    for (int i = 0; i < num_particles; ++i) {
-        if (particles[i].size > 0) {
-            int screen_x = (particles[i].x - player_x + CAM_W/2 - particles[i].size/2)/CAM_W * viewport.w; 
-            int screen_y = viewport.h - ((particles[i].y - player_y + CAM_H/2 + particles[i].size/2)/CAM_H * viewport.h); 
-            SDL_RenderFillRect(renderer, &(SDL_Rect){screen_x, screen_y, particles[i].size/CAM_W * viewport.w, particles[i].size/CAM_H * viewport.h}); 
-        }  
+void render_particles(struct RenderQueue *queue, struct Particles *particles, enum Emitter emitter, float player_x, float player_y) {
+    SDL_Rect viewport = queue->viewport; 
+    float scale_x = viewport.w / CAM_W, scale_y = viewport.h / CAM_H; 
+    unsigned start = particles->start[emitter], end = start + particles->count[emitter]; 
+    for (unsigned i = start; i < end; ++i) {
+        float size = particles->size[i]; 
+        int screen_x = (particles->x[i] - player_x + CAM_W/2 - size/2) * scale_x; 
+        int screen_y = viewport.h - (particles->y[i] - player_y + CAM_H/2 + size/2) * scale_y; 
+        queue_fill_rect(queue, ParticleLayer, (SDL_Rect){screen_x, screen_y, size * scale_x, size * scale_y}, (SDL_Color){123, 226, 237, 255}); 
     }
 }
 
-// general texture renderer for game objects
-void render_texture(SDL_Renderer *renderer, SDL_Texture *texture, float x, float y, float w, float h, float angle, float anchor_x, float anchor_y) {
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
+// RENDER SNAPSHOTS 
+// the simulation runs on its own thread, so render_game never reads the live game. Instead the simulation publishes a copy of everything 
+// render_game needs after its steps, through a triple buffer: the writer always has a back slot to itself, the reader a front slot, and they 
+// swap with the middle one atomically, so neither side ever waits on the other and the reader always gets the newest complete snapshot 
+#define SNAPSHOT_FRESH 4 // set on the middle index while it holds a snapshot the reader has not taken 
+
+struct GameSnapshot {
+    unsigned state; // enum PlayerState 
+    float x, y, rot; 
+    float vel_x, vel_y, rot_vel; // for the drag creasent and the boost trail 
+    int on_drag, on_boost; 
+    struct Particles particles; 
+    char timer_string[8]; 
+    SDL_Color timer_color; 
+    Uint64 input_counter, step_counter; // the newest input the simulation took and when its step finished, for the latency measurement 
+}; 
+
+struct SnapshotBuffer {
+    struct GameSnapshot slots[3]; 
+    int back; // only touched by the writer 
+    int front; // only touched by the reader 
+    SDL_atomic_t middle; 
+}; 
+
+void init_snapshot_buffer(struct SnapshotBuffer *buffer) {
+    buffer->back = 0; 
+    SDL_AtomicSet(&buffer->middle, 1); 
+    buffer->front = 2; 
+}
+
+// the writer fills this and then publishes it 
+struct GameSnapshot *get_back_snapshot(struct SnapshotBuffer *buffer) {
+    return &buffer->slots[buffer->back]; 
+}
+
+void publish_snapshot(struct SnapshotBuffer *buffer) {
+    buffer->back = SDL_AtomicSet(&buffer->middle, buffer->back | SNAPSHOT_FRESH) & ~SNAPSHOT_FRESH; 
+}
+
+// the newest published snapshot, which stays the reader's until the next read 
+struct GameSnapshot *read_snapshot(struct SnapshotBuffer *buffer) {
+    // the writer can only ever replace a fresh middle with another fresh one, so the check cannot go stale before the swap 
+    if (SDL_AtomicGet(&buffer->middle) & SNAPSHOT_FRESH) buffer->front = SDL_AtomicSet(&buffer->middle, buffer->front) & ~SNAPSHOT_FRESH; 
+    return &buffer->slots[buffer->front]; 
+}
+
+// the snapshot the last read returned, without looking for a newer one 
+struct GameSnapshot *get_front_snapshot(struct SnapshotBuffer *buffer) {
+    return &buffer->slots[buffer->front]; 
+}
 
-    SDL_RenderCopyEx(renderer, texture, NULL, &(SDL_Rect){(x-anchor_x)/CAM_W * viewport.w, viewport.h - (y-anchor_y + h)/CAM_H * viewport.h, w/CAM_W * viewport.w, h/CAM_H * viewport.h}, angle * -180/M_PI, &(SDL_Point){anchor_x/CAM_W * viewport.w, anchor_y/CAM_H * viewport.h}, SDL_FLIP_NONE); 
+// TIMESTAMPED INPUT 
+// every change to the controls is queued with the time SDL stamped on its event, and the simulation applies it at the first step at or after 
+// that time, one change per step so a press and release in the same frame still get a step each. The simulation never waits on the app for input. 
+// SDL2 stamps an event when it is pumped, not when the key went down, and the app pumps once a frame, so a press is only as exact as the frame's 
+// poll (up to a frame late, 16.7 ms at 60 Hz). The replays record the controls per step, so they play back exactly what the simulation did 
+#define INPUT_RING_SIZE 64 
+
+struct GameInput {
+    Uint32 time; // SDL_GetTicks time of the event 
+    unsigned controls; // all the controls after the change, bit 0 is the left thruster, bit 1 the right, like the replays 
+    Uint64 counter; // the same time on the performance counter, for the latency measurement 
+}; 
+
+struct InputQueue {
+    struct GameInput ring[INPUT_RING_SIZE]; 
+    SDL_atomic_t write_i, read_i; 
+    unsigned controls; // after the last queued input, only touched by the app 
+}; 
+
+void init_input_queue(struct InputQueue *inputs) {
+    SDL_AtomicSet(&inputs->write_i, 0); 
+    SDL_AtomicSet(&inputs->read_i, 0); 
+    inputs->controls = 0; 
+}
+
+// called on the app's thread 
+void queue_input(struct InputQueue *inputs, Uint32 time, unsigned controls) {
+    if (controls == inputs->controls) return; // key repeats 
+    inputs->controls = controls; 
+
+    // only full if the simulation has stalled, and since every input carries all the controls the next one still gets them right 
+    unsigned write_i = SDL_AtomicGet(&inputs->write_i); 
+    if (write_i - SDL_AtomicGet(&inputs->read_i) >= INPUT_RING_SIZE) return; 
+    Uint64 counter = SDL_GetPerformanceCounter() - (Uint64)(SDL_GetTicks() - time) * SDL_GetPerformanceFrequency() / 1000; 
+    inputs->ring[write_i % INPUT_RING_SIZE] = (struct GameInput){time, controls, counter}; 
+    SDL_AtomicSet(&inputs->write_i, write_i + 1); 
+}
+
+// called on the simulation thread, applies the oldest input from at or before the given time to the controls 
+// returns the counter of the input taken, 0 if there was none 
+Uint64 take_input(struct InputQueue *inputs, Uint32 time, unsigned *controls) {
+    unsigned read_i = SDL_AtomicGet(&inputs->read_i); 
+    if (read_i == (unsigned)SDL_AtomicGet(&inputs->write_i) || !SDL_TICKS_PASSED(time, inputs->ring[read_i % INPUT_RING_SIZE].time)) return 0; 
+    struct GameInput *input = &inputs->ring[read_i % INPUT_RING_SIZE]; 
+    *controls = input->controls; 
+    Uint64 counter = input->counter; 
+    SDL_AtomicSet(&inputs->read_i, read_i + 1); 
+    return counter; 
+}
+
+// where an input has got to on its way to the screen, as performance counter times 
+struct InputTrace {
+    Uint64 input; // the event, as stamped when the app polled it 
+    Uint64 step; // the end of the simulation step that took it 
+    Uint64 render; // the render_game that first drew that step 
+}; 
+
+// general texture renderer for game objects, alpha replaces setting the texture's alpha mod 
+void render_texture(struct RenderQueue *queue, enum RenderLayer layer, SDL_Texture *texture, float x, float y, float w, float h, float angle, float anchor_x, float anchor_y, Uint8 alpha) {
+    SDL_Rect viewport = queue->viewport; 
+
+    SDL_Rect dst = {(x-anchor_x)/CAM_W * viewport.w, viewport.h - (y-anchor_y + h)/CAM_H * viewport.h, w/CAM_W * viewport.w, h/CAM_H * viewport.h}; 
+    SDL_Point center = {anchor_x/CAM_W * viewport.w, anchor_y/CAM_H * viewport.h}; 
+    queue_rotated_quad(queue, layer, texture, NULL, (SDL_FRect){dst.x, dst.y, dst.w, dst.h}, angle * -180/M_PI, (SDL_FPoint){center.x, center.y}, (SDL_Color){255, 255, 255, alpha}); 
 }
 
 
@@ -67,6 +235,8 @@ struct Game {
     // some tiles need higher resolution than others 
     SDL_Texture *low_res_tiles; 
     SDL_Texture *high_res_tiles; 
+    SDL_Texture *map_texture; // whole map baked on entry, so each frame is just one copy 
+    int map_tile_px; // pixels per tile in the map texture 
 
     Mix_Music* music; 
 
@@ -89,14 +259,8 @@ struct Game {
         SDL_Texture *texture; 
 
         // particles for thruster, explosion, and force tiles 
-        struct Particle particles[30]; 
-        unsigned next_particle_i; 
+        struct Particles particles; 
         float particle_timer; 
-
-        struct Particle explosion_particles[64]; 
-
-        struct Particle force_particles[12]; 
-        unsigned next_force_particle_i; 
         float force_particle_timer; 
 
         SDL_Texture *drag_creasent; 
@@ -114,16 +278,34 @@ struct Game {
     float record; 
     float timer; 
 
-    SDL_Texture *timer_texture; 
+    // drawn from the glyph atlas, so updating it is only a sprintf 
+    char timer_string[8]; 
+    SDL_Color timer_color; 
     float timer_animation_timer; 
     
     // for display at top 
     SDL_Texture *level_name; 
+
+    // telemetry for the current attempt, filled in as it is played and recorded on exit
+    struct Attempt attempt; 
+
+    // inputs and frame times of the current attempt so it can be replayed later 
+    struct Replay replay; 
+
+    // the simulation thread and what it shares with the app: the inputs come in, the requested state change and the snapshots go out 
+    SDL_Thread *thread; 
+    SDL_atomic_t running; 
+    struct InputQueue inputs; 
+    Uint64 input_counter, step_counter; // only touched by the simulation, published with the snapshots 
+    SDL_atomic_t next_state; // InGame until the simulation asks for a transition 
+    SDL_atomic_t quality_level; // index into quality_levels, set by the app from its governor 
+    struct SnapshotBuffer snapshots; 
 }; 
 
-void init_game(struct Game *game, SDL_Renderer *renderer) { 
-    game->low_res_tiles = IMG_LoadTexture(renderer, "assets/low_res_tiles.png"); 
-    game->high_res_tiles = IMG_LoadTexture(renderer, "assets/high_res_tiles.png"); 
+void init_game(struct Game *game, SDL_Renderer *renderer, struct Assets *assets) { 
+    // the images are shared with the editor and the menus 
+    game->low_res_tiles = load_asset(assets, renderer, "assets/low_res_tiles.png"); 
+    game->high_res_tiles = load_asset(assets, renderer, "assets/high_res_tiles.png"); 
 
     game->music = Mix_LoadMUS("assets/music.mp3"); 
     Mix_VolumeMusic(32); 
@@ -139,17 +321,22 @@ void init_game(struct Game *game, SDL_Renderer *renderer) {
     Mix_Volume(GRAVITY_CHANNEL, 0); 
 
     // player 
-    game->player.texture = IMG_LoadTexture(renderer, "assets/space_ship.png"); 
-    game->player.drag_creasent = IMG_LoadTexture(renderer, "assets/drag_creasent.png"); 
+    game->player.texture = load_asset(assets, renderer, "assets/space_ship.png"); 
+    game->player.drag_creasent = load_asset(assets, renderer, "assets/drag_creasent.png"); 
     game->player.thruster_sound = Mix_LoadWAV("assets/thruster.wav");
     game->player.explosion_sound = Mix_LoadWAV("assets/explosion.wav");  
+
+    init_replay(&game->replay); 
+    SDL_AtomicSet(&game->quality_level, NUM_QUALITY_LEVELS - 1); 
 }
 
-void cleanup_game(struct Game *game) {
+void cleanup_game(struct Game *game, struct Assets *assets) {
+    cleanup_replay(&game->replay); 
+
     Mix_FreeChunk(game->player.explosion_sound); 
     Mix_FreeChunk(game->player.thruster_sound);
-    SDL_DestroyTexture(game->player.drag_creasent); 
-    SDL_DestroyTexture(game->player.texture); 
+    release_asset(assets, game->player.drag_creasent); 
+    release_asset(assets, game->player.texture); 
 
     Mix_FreeChunk(game->win_sound); 
     Mix_FreeChunk(game->gravity_sound); 
@@ -160,22 +347,83 @@ void cleanup_game(struct Game *game) {
 
     Mix_FreeMusic(game->music); 
 
-    SDL_DestroyTexture(game->high_res_tiles); 
-    SDL_DestroyTexture(game->low_res_tiles); 
+    release_asset(assets, game->high_res_tiles); 
+    release_asset(assets, game->low_res_tiles); 
 }
 
-void enter_game(struct Game *game, char *level_path, TTF_Font *font, SDL_Renderer *renderer) {
-    // read in from the file all important info 
-    FILE *file = fopen(level_path, "rb"); 
-    char level_name[32]; 
-    fread(level_name, sizeof(level_name), 1, file); 
-    fread(&game->player.x, sizeof(float), 1, file); 
-    fread(&game->player.y, sizeof(float), 1, file); 
-    fread(&game->player.rot, sizeof(float), 1, file); 
-    fread(&game->record, sizeof(float), 1, file);
-    fread(&game->map, sizeof(game->map), 1, file); 
-    fclose(file); 
+void init_map_texture(struct Game *game, SDL_Renderer *renderer) {
+    int tiles_w = MAP_W + 2 * MAP_TEXTURE_BORDER, tiles_h = MAP_H + 2 * MAP_TEXTURE_BORDER; 
+    // a max of 0 means there is no limit 
+    SDL_RendererInfo info; 
+    int fits = SDL_GetRendererInfo(renderer, &info) == 0
+        && (info.max_texture_width == 0 || info.max_texture_width >= tiles_w * MAP_TEXTURE_TILE_PX)
+        && (info.max_texture_height == 0 || info.max_texture_height >= tiles_h * MAP_TEXTURE_TILE_PX); 
+    int tile_px = game->map_tile_px = fits? MAP_TEXTURE_TILE_PX: MAP_TEXTURE_SMALL_TILE_PX; 
+    game->map_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, tiles_w * tile_px, tiles_h * tile_px); 
+
+    // switching targets resets the viewport, so keep the target and the letterboxed viewport to put back after 
+    SDL_Texture *target = SDL_GetRenderTarget(renderer); 
+    SDL_Rect viewport; 
+    SDL_RenderGetViewport(renderer, &viewport); 
+    SDL_SetRenderTarget(renderer, game->map_texture); 
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+    SDL_RenderClear(renderer); 
+
+    // the high res tiles get shrunk when the texture is baked small, so filter them while baking 
+    SDL_SetTextureScaleMode(game->high_res_tiles, SDL_ScaleModeLinear); 
+    struct Batch low_batch, high_batch; 
+    init_batch(&low_batch, renderer, game->low_res_tiles); 
+    init_batch(&high_batch, renderer, game->high_res_tiles); 
+    for (int row = -MAP_TEXTURE_BORDER; row < MAP_H + MAP_TEXTURE_BORDER; ++row) {
+        for (int col = -MAP_TEXTURE_BORDER; col < MAP_W + MAP_TEXTURE_BORDER; ++col) {
+            unsigned char tile = (row >= 0 && row < MAP_H && col >= 0 && col < MAP_W)? game->map[row][col]: Solid; // outside of the map is drawn as solid 
+            SDL_Rect src = get_tile_src(tile); 
+            SDL_FRect dst = {(col + MAP_TEXTURE_BORDER) * tile_px, (MAP_H + MAP_TEXTURE_BORDER - 1 - row) * tile_px, tile_px, tile_px}; 
+            batch_quad(is_high_res_tile(tile)? &high_batch: &low_batch, &src, dst, BATCH_WHITE); 
+        }
+    }
+    flush_batch(&low_batch); 
+    flush_batch(&high_batch); 
+
+    // the glow is added over the tiles here once, so render_game draws it with the map for free 
+    struct Glow glow; 
+    init_glow(&glow); 
+    bake_glow(&glow, game->map); 
+    SDL_Texture *glow_texture = create_glow_texture(renderer); 
+    upload_glow(&glow, glow_texture); 
+    int glow_edge = (MAP_TEXTURE_BORDER - GLOW_RADIUS) * tile_px; 
+    SDL_RenderCopy(renderer, glow_texture, NULL, &(SDL_Rect){glow_edge, glow_edge, GLOW_W / GLOW_TEXELS_PER_TILE * tile_px, GLOW_H / GLOW_TEXELS_PER_TILE * tile_px}); 
+    SDL_DestroyTexture(glow_texture); 
+    cleanup_glow(&glow); 
+
+    SDL_SetRenderTarget(renderer, target); 
+    SDL_RenderSetViewport(renderer, &viewport); 
+}
+
+void update_timer_text(struct Game *game) {
+    snprintf(game->timer_string, sizeof(game->timer_string), "%.1f", game->timer); 
+    game->timer_color = (game->timer < game->record) ? (SDL_Color){0, 180, 0, 255} : (SDL_Color){180, 0, 0, 255}; 
+}
+
+// copies what render_game draws out of the live game, on whichever thread is simulating it 
+void publish_game_snapshot(struct Game *game) {
+    struct GameSnapshot *snapshot = get_back_snapshot(&game->snapshots); 
+    struct Player *player = &game->player; 
+    snapshot->state = player->state; 
+    snapshot->x = player->x; snapshot->y = player->y; snapshot->rot = player->rot; 
+    snapshot->vel_x = player->vel_x; snapshot->vel_y = player->vel_y; snapshot->rot_vel = player->rot_vel; 
+    snapshot->on_drag = player->collision_cache[Drag]; 
+    snapshot->on_boost = player->collision_cache[Boost]; 
+    snapshot->particles = player->particles; 
+    memcpy(snapshot->timer_string, game->timer_string, sizeof(snapshot->timer_string)); 
+    snapshot->timer_color = game->timer_color; 
+    snapshot->input_counter = game->input_counter; 
+    snapshot->step_counter = game->step_counter; 
+    publish_snapshot(&game->snapshots); 
+}
 
+// resets everything for a new attempt once the level data (map, spawn, record) is in place, also used by the replay renderer 
+void start_game(struct Game *game, char *level_name, TTF_Font *font, SDL_Renderer *renderer) {
     // get base play info
     game->player.state = Playing; 
     game->player.vel_x = 0; game->player.vel_y = 0; 
@@ -183,29 +431,64 @@ void enter_game(struct Game *game, char *level_path, TTF_Font *font, SDL_Rendere
     game->player.right_thruster_control = 0; game->player.left_thruster_control = 0;
 
     // initialize particles 
-    for (int i = 0; i < 30; ++i) game->player.particles[i].size = 0; 
-    game->player.next_particle_i = 0; 
+    init_particles(&game->player.particles); 
     game->player.particle_timer = 0; 
-
-    for (int i = 0; i < 12; ++i) game->player.force_particles[i].size = 0; 
-    game->player.next_force_particle_i = 0; 
     game->player.force_particle_timer = 0; 
 
     Mix_PlayMusic(game->music, -1); 
 
     game->timer = 0; 
 
-    init_text(&game->timer_texture, "0.0", font, (SDL_Color){0, 180, 0, 255}, renderer); 
+    update_timer_text(game); 
     game->timer_animation_timer = 0; 
 
     init_text(&game->level_name, level_name, font, (SDL_Color){0, 180, 180, 255}, renderer); 
+    init_map_texture(game, renderer); 
+
+    memset(&game->attempt, 0, sizeof(game->attempt)); 
+    begin_replay(&game->replay, level_name, game->player.x, game->player.y, game->player.rot, game->record, game->map); 
+
+    game->input_counter = game->step_counter = 0; 
+    init_snapshot_buffer(&game->snapshots); 
+    publish_game_snapshot(game); 
+}
+
+void enter_game(struct Game *game, char *level_path, TTF_Font *font, SDL_Renderer *renderer) {
+    // read in from the file all important info 
+    FILE *file = fopen(level_path, "rb"); 
+    char level_name[32]; 
+    fread(level_name, sizeof(level_name), 1, file); 
+    fread(&game->player.x, sizeof(float), 1, file); 
+    fread(&game->player.y, sizeof(float), 1, file); 
+    fread(&game->player.rot, sizeof(float), 1, file); 
+    fread(&game->record, sizeof(float), 1, file);
+    fread(&game->map, sizeof(game->map), 1, file); 
+    fclose(file); 
 
+    start_game(game, level_name, font, renderer); 
 }
 
-void exit_game(struct Game *game, char *level_path, enum LevelType last_type, unsigned last_id, unsigned *num_completed) {
+void exit_game(struct Game *game, char *level_path, enum LevelType last_type, unsigned last_id, unsigned *num_completed, struct Telemetry *telemetry) {
     Mix_FadeOutMusic(500);
-    SDL_DestroyTexture(game->timer_texture); 
     SDL_DestroyTexture(game->level_name); 
+    SDL_DestroyTexture(game->map_texture); 
+
+    // finish off the attempt record and hand it to the telemetry ring 
+    game->attempt.level_type = last_type; 
+    game->attempt.level_id = last_id; 
+    game->attempt.outcome = game->player.state; 
+    game->attempt.duration = game->timer; 
+    game->attempt.death_row = game->player.state == Exploding? floorf(game->player.y): -1; 
+    game->attempt.death_col = game->player.state == Exploding? floorf(game->player.x): -1; 
+    record_attempt(telemetry, &game->attempt); 
+
+    // keep the replay of the last attempt, and of every new record so they can be reviewed later 
+    char replay_path[64]; 
+    save_replay(&game->replay, REPLAY_DIR "/last.rpl", last_type, last_id); 
+    if (game->player.state == Winning && game->timer < game->record) {
+        sprintf(replay_path, REPLAY_DIR "/%s_%d.rpl", last_type == OfficialLevel ? "official" : "custom", last_id); 
+        save_replay(&game->replay, replay_path, last_type, last_id); 
+    }
 
     // if they won in less time than the record, update the record 
     if (game->player.state == Winning && game->timer < game->record) {
@@ -274,13 +557,9 @@ void update_player_state(struct Player *player, Mix_Chunk *win_sound) {
         player->state = Exploding; 
         // explositon particles generation
         for (int i = 0; i < 64; ++i) {
-            player->explosion_particles[i].x = player->x; 
-            player->explosion_particles[i].y = player->y; 
             float rot = (float)rand()/RAND_MAX * 6.28;
             float speed = 0.5 + (float)rand()/RAND_MAX * 3; 
-            player->explosion_particles[i].x_vel = cos(rot) * speed; 
-            player->explosion_particles[i].y_vel = sin(rot) * speed; 
-            player->explosion_particles[i].size = 0.1 + (float)rand()/RAND_MAX * 0.1; 
+            emit_particle(&player->particles, ExplosionEmitter, player->x, player->y, cos(rot) * speed, sin(rot) * speed, 0.1 + (float)rand()/RAND_MAX * 0.1); 
         }
 
         // sound
@@ -299,18 +578,14 @@ void update_player_state(struct Player *player, Mix_Chunk *win_sound) {
 }
 
 
-void update_timer(struct Game *game, float delta_time, TTF_Font *font, SDL_Renderer *renderer) {
+void update_timer(struct Game *game, float delta_time) {
     // update the timer every tenth of a second 
     if (game->player.vel_x != 0 || game->player.vel_y != 0 || game->player.rot_vel != 0) {
         game->timer += delta_time; 
         game->timer_animation_timer += delta_time; 
         if (game->timer_animation_timer > 0.1) {
             game->timer_animation_timer -= 0.1; 
-            
-            SDL_DestroyTexture(game->timer_texture); 
-            char string[8]; sprintf(string, "%.1f", game->timer); 
-            SDL_Color color = (game->timer < game->record) ? (SDL_Color){0, 180, 0, 255} : (SDL_Color){180, 0, 0, 255}; 
-            init_text(&game->timer_texture, string, font, color, renderer); 
+            update_timer_text(game); 
         }
     }
 }
@@ -365,7 +640,8 @@ void update_player_movement(struct Player *player, float delta_time) {
     player->rot += player->rot_vel * delta_time; 
 }
 
-void emit_player_particles(struct Player *player, float delta_time) {
+// rate scales how often particles are emitted, 1 is the full rate 
+void emit_player_particles(struct Player *player, float delta_time, float rate) {
     // check if it is time for a new particle 
     int spawns[2] = {
         (player->left_thruster_control || player->collision_cache[ThrustersOn]) && !player->collision_cache[ThrustersOff], // left
@@ -375,8 +651,8 @@ void emit_player_particles(struct Player *player, float delta_time) {
     int is_spawn_time = 0; 
     if (spawns[0] || spawns[1]) {
         player->particle_timer += delta_time; 
-        if (player->particle_timer >= 0.025) {
-            player->particle_timer -= 0.025; 
+        if (player->particle_timer >= 0.025 / rate) {
+            player->particle_timer -= 0.025 / rate; 
             is_spawn_time = 1; 
         }
     }
@@ -386,27 +662,25 @@ void emit_player_particles(struct Player *player, float delta_time) {
         int offset_mults[] = {1, -1}; 
         for (int i = 0; i < 2; ++i) {
             if (spawns[i]) {
-                player->particles[player->next_particle_i].x = player->x + -0.125 * cosf(player->rot) - offset_mults[i] * 0.2 * sinf(player->rot); 
-                player->particles[player->next_particle_i].y = player->y + -0.125 * sinf(player->rot) + offset_mults[i] * 0.2 * cosf(player->rot);
+                float x = player->x + -0.125 * cosf(player->rot) - offset_mults[i] * 0.2 * sinf(player->rot); 
+                float y = player->y + -0.125 * sinf(player->rot) + offset_mults[i] * 0.2 * cosf(player->rot);
                 float rot = player->rot + (float)rand()/RAND_MAX * 0.25 - 0.125; 
                 float speed = player->collision_cache[StrongerThrusters]? 2: player->collision_cache[WeakerThrusters]? 0.5: 1; 
-                player->particles[player->next_particle_i].x_vel = player->vel_x - cos(rot) * speed; 
-                player->particles[player->next_particle_i].y_vel = player->vel_y - sin(rot) * speed; 
-                player->particles[player->next_particle_i].size = player->collision_cache[StrongerThrusters]? 0.125: player->collision_cache[WeakerThrusters]? 0.075: 0.1; 
-                player->next_particle_i = (player->next_particle_i + 1) % 30; 
+                float size = player->collision_cache[StrongerThrusters]? 0.125: player->collision_cache[WeakerThrusters]? 0.075: 0.1; 
+                emit_particle(&player->particles, ThrusterEmitter, x, y, player->vel_x - cos(rot) * speed, player->vel_y - sin(rot) * speed, size); 
             }
         }
     }
 }
 
-void emit_player_force_particles(struct Player *player, float delta_time) {
+void emit_player_force_particles(struct Player *player, float delta_time, float rate) {
     int should_spawn = (player->collision_cache[LeftForce] || player->collision_cache[RightForce] || player->collision_cache[UpForce] || player->collision_cache[DownForce] || player->collision_cache[ClockwiseTorque] || player->collision_cache[CounterClockwiseTorque]); 
     
     if (should_spawn) {
         int is_spawn_time = 0; 
         player->force_particle_timer += delta_time; 
-        if (player->force_particle_timer > 0.025) {
-            player->force_particle_timer -= 0.025; 
+        if (player->force_particle_timer > 0.025 / rate) {
+            player->force_particle_timer -= 0.025 / rate; 
             is_spawn_time = 1; 
         }
 
@@ -423,16 +697,23 @@ void emit_player_force_particles(struct Player *player, float delta_time) {
                 back_x = player->x + (12.0/16 * -0.125 * cosf(player->rot) - -0.25 * sinf(player->rot)), end_y = player->y + (-0.125 * sinf(player->rot) + -0.25 * cosf(player->rot)); 
             }
             float dist = (float)rand()/RAND_MAX; 
-            player->force_particles[player->next_force_particle_i].x = choice ? start_x + dist * (back_x - start_x): start_x + dist * (back_x - start_x);  
-            player->force_particles[player->next_force_particle_i].y = choice ? start_y + dist * (end_y - start_y): start_y + dist * (end_y - start_y);  
-            player->force_particles[player->next_force_particle_i].x_vel = player->vel_x + ((player->collision_cache[LeftForce] && !player->collision_cache[RightForce])? 1.75 : (player->collision_cache[RightForce] && !player->collision_cache[LeftForce])? -1.75: 0); 
-            player->force_particles[player->next_force_particle_i].y_vel = player->vel_y + ((player->collision_cache[DownForce] && !player->collision_cache[UpForce])? 1.75 : (player->collision_cache[UpForce] && !player->collision_cache[DownForce])? -1.75: 0);
-            player->force_particles[player->next_force_particle_i].size = 0.1; 
-            player->next_force_particle_i = (player->next_force_particle_i + 1) % 12; 
+            float x_vel = player->vel_x + ((player->collision_cache[LeftForce] && !player->collision_cache[RightForce])? 1.75 : (player->collision_cache[RightForce] && !player->collision_cache[LeftForce])? -1.75: 0); 
+            float y_vel = player->vel_y + ((player->collision_cache[DownForce] && !player->collision_cache[UpForce])? 1.75 : (player->collision_cache[UpForce] && !player->collision_cache[DownForce])? -1.75: 0);
+            emit_particle(&player->particles, ForceEmitter, start_x + dist * (back_x - start_x), start_y + dist * (end_y - start_y), x_vel, y_vel, 0.1); 
         }
     }
 }
 
+// marks the current cell and every touched tile type in the attempt telemetry 
+void update_attempt(struct Attempt *attempt, struct Player *player) {
+    int row = floorf(player->y), col = floorf(player->x); 
+    if (0 <= row && row < MAP_H && 0 <= col && col < MAP_W) attempt->visited[row][col / 8] |= 1 << (col % 8); 
+
+    for (int i = 0; i < 17; ++i) {
+        if (player->collision_cache[i]) attempt->tiles_touched |= 1u << i; 
+    }
+}
+
 // keep this together as well since it is made of a bunch of small interrelated parts 
 void update_game_sound(struct Game *game) {
     // thrusters on or off
@@ -491,22 +772,25 @@ void update_game_sound(struct Game *game) {
     }
 }
 
-void update_game(struct Game *game, float delta_time, TTF_Font *font, SDL_Renderer *renderer, enum AppState *next_state) {
+void update_game(struct Game *game, float delta_time, enum AppState *next_state) {
+    record_replay_frame(&game->replay, delta_time, game->player.left_thruster_control, game->player.right_thruster_control); 
+
     // update the caches if they might be needed in the state, then update the player state. Then execute different functions based on the state that was just updated
     if (game->player.state == Playing || game->player.state == Winning) update_player_caches(&game->player, game->map); 
     update_player_state(&game->player, game->win_sound); 
     
     // updates if playing 
     if (game->player.state == Playing) {
-        update_timer(game, delta_time, font, renderer); 
+        update_attempt(&game->attempt, &game->player); 
+        update_timer(game, delta_time); 
 
         update_player_movement(&game->player, delta_time); 
 
-        update_particles(game->player.particles, 30, delta_time, 3.0, game->map); 
-        emit_player_particles(&game->player, delta_time); 
+        update_particles(&game->player.particles, ThrusterEmitter, delta_time, 3.0, game->map); 
+        emit_player_particles(&game->player, delta_time, quality_levels[SDL_AtomicGet(&game->quality_level)].particle_rate); 
 
-        update_particles(game->player.force_particles, 12, delta_time, 3.0, game->map);
-        emit_player_force_particles(&game->player, delta_time); 
+        update_particles(&game->player.particles, ForceEmitter, delta_time, 3.0, game->map);
+        emit_player_force_particles(&game->player, delta_time, quality_levels[SDL_AtomicGet(&game->quality_level)].particle_rate); 
 
         update_game_sound(game); 
     }
@@ -532,22 +816,15 @@ void update_game(struct Game *game, float delta_time, TTF_Font *font, SDL_Render
         
 
         // update particles (no more emmission, but update)
-        update_particles(game->player.particles, 30, delta_time, 3.0, game->map); 
-        update_particles(game->player.force_particles, 12, delta_time, 3.0, game->map); 
+        update_particles(&game->player.particles, ThrusterEmitter, delta_time, 3.0, game->map); 
+        update_particles(&game->player.particles, ForceEmitter, delta_time, 3.0, game->map); 
     }
 
     else if (game->player.state == Exploding) {
-        update_particles(game->player.explosion_particles, 64, delta_time, 5.0, game->map);
+        update_particles(&game->player.particles, ExplosionEmitter, delta_time, 5.0, game->map);
 
-        int done_exploding = 1; 
-        for (int i = 0; i < 64; ++i) {
-            if (game->player.explosion_particles[i].size > 0) {
-                done_exploding = 0; 
-                break; 
-            }
-        }
-
-        if (done_exploding) {
+        // done once every explosion particle is gone 
+        if (game->player.particles.count[ExplosionEmitter] == 0) {
             *next_state = InOverlay; 
         }
     }
@@ -557,83 +834,171 @@ void update_game(struct Game *game, float delta_time, TTF_Font *font, SDL_Render
 
 
 
-void render_game(struct Game *game, SDL_Renderer *renderer) {
+// draws the newest snapshot the simulation published, the textures and the map do not change during an attempt so those come from the game 
+void render_game(struct Game *game, struct RenderQueue *queue, struct Glyphs *glyphs) {
+    struct GameSnapshot *snapshot = read_snapshot(&game->snapshots); 
+    struct Quality *quality = &quality_levels[SDL_AtomicGet(&game->quality_level)]; 
+
     // tile Background 
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
-    for (int row = floorf(game->player.y - CAM_H/2.0); row <= floorf(game->player.y + CAM_H/2.0); ++row) {
-        for (int col = floorf(game->player.x - CAM_W/2.0); col <= floorf(game->player.x + CAM_W/2.0); ++col) {
-            // lets do these coordinate transformations clearly 
-            int screen_x = (col - game->player.x + CAM_W/2.0)/CAM_W * viewport.w; 
-            int screen_y = viewport.h - ((row - game->player.y + CAM_H/2.0 + 1)/CAM_H * viewport.h); 
-            int tile_res = (row >= 0 && row < MAP_H && col >= 0 && col < MAP_W && (game->map[row][col] == DownForce || game->map[row][col] == UpForce || game->map[row][col] == LeftForce || game->map[row][col] == RightForce || game->map[row][col] == CounterClockwiseTorque || game->map[row][col] == ClockwiseTorque))? 64: 16; 
-            int tile_offset = tile_res == 64? (game->map[row][col] - 11) * 64 : row >= 0 && row < MAP_H && col >= 0 && col < MAP_W? game->map[row][col] * 16: 16; 
-            SDL_RenderCopy(renderer, tile_res == 64? game->high_res_tiles: game->low_res_tiles, &(SDL_Rect){tile_offset, 0, tile_res, tile_res}, &(SDL_Rect){screen_x, screen_y, viewport.w/CAM_W + 1, viewport.h/CAM_H + 1});  // add one to dimensions to cover up disconnects 
-        }
-    }  
+    SDL_Rect viewport = queue->viewport; 
+
+    // the part of the baked map under the camera, in texture pixels (the texture's top row is the top of the border) 
+    int tile_px = game->map_tile_px; 
+    float left = (snapshot->x - CAM_W/2.0 + MAP_TEXTURE_BORDER) * tile_px; 
+    float top = (MAP_H + MAP_TEXTURE_BORDER - (snapshot->y + CAM_H/2.0)) * tile_px; 
+    // source rects are whole pixels, so take the pixels around the camera and shift the copy by the fraction to keep scrolling smooth 
+    SDL_Rect src = {floorf(left), floorf(top), ceilf(CAM_W * tile_px) + 2, ceilf(CAM_H * tile_px) + 2}; 
+    float scale_x = viewport.w / (CAM_W * tile_px), scale_y = viewport.h / (CAM_H * tile_px); 
+    queue_quad(queue, GroundLayer, game->map_texture, &src, (SDL_FRect){(src.x - left) * scale_x, (src.y - top) * scale_y, src.w * scale_x, src.h * scale_y}, BATCH_WHITE); 
 
     // timer and level name 
-    render_menu_text(renderer, game->timer_texture, 0, 0, 1, Left); 
-    render_menu_text(renderer, game->level_name, 0, UI_W , 0.75, Right);
+    render_glyph_text(queue, glyphs, snapshot->timer_string, snapshot->timer_color, 0, 0, 1, Left); 
+    render_menu_text(queue, game->level_name, 0, UI_W , 0.75, Right);
 
     // player and particles 
-    if (game->player.state == Playing || game->player.state == Winning) {
-        render_particles(renderer, game->player.particles, 30, game->player.x, game->player.y); 
-        render_particles(renderer, game->player.force_particles, 12, game->player.x, game->player.y); 
+    if (snapshot->state == Playing || snapshot->state == Winning) {
+        render_particles(queue, &snapshot->particles, ThrusterEmitter, snapshot->x, snapshot->y); 
+        render_particles(queue, &snapshot->particles, ForceEmitter, snapshot->x, snapshot->y); 
 
-        render_texture(renderer, game->player.texture, CAM_W/2.0, CAM_H/2, 0.5, 0.5, game->player.rot, 0.125, 0.25); 
+        render_texture(queue, SpriteLayer, game->player.texture, CAM_W/2.0, CAM_H/2, 0.5, 0.5, snapshot->rot, 0.125, 0.25, 255); 
     }
     // drag creasent and boost trail 
-    if (game->player.state == Playing) {
+    if (snapshot->state == Playing) {
         // drag creasent 
-        if (game->player.collision_cache[Drag]) {
-            float speed = sqrt(game->player.vel_x * game->player.vel_x + game->player.vel_y * game->player.vel_y); 
-            float x_offset = game->player.vel_x/speed * 0.5; 
-            float y_offset = game->player.vel_y/speed * 0.5; 
-
-            if (game->map[(int)floorf(game->player.y + y_offset)][(int)floorf(game->player.x + x_offset)] == Drag) { // only apply the drag creasent if their is a drag collision but also the creasent would be on the drag block 
-                SDL_SetTextureAlphaMod(game->player.drag_creasent, speed * 48 < 256? speed * 48 : 255);
-                render_texture(renderer, game->player.drag_creasent, CAM_W/2.0 + x_offset, CAM_H/2 + y_offset, 0.5, 1, atan2(game->player.vel_y, game->player.vel_x), 0.5, 0.5); 
+        if (snapshot->on_drag && quality->effects) {
+            float speed = sqrt(snapshot->vel_x * snapshot->vel_x + snapshot->vel_y * snapshot->vel_y); 
+            float x_offset = snapshot->vel_x/speed * 0.5; 
+            float y_offset = snapshot->vel_y/speed * 0.5; 
+
+            if (game->map[(int)floorf(snapshot->y + y_offset)][(int)floorf(snapshot->x + x_offset)] == Drag) { // only apply the drag creasent if their is a drag collision but also the creasent would be on the drag block 
+                render_texture(queue, EffectLayer, game->player.drag_creasent, CAM_W/2.0 + x_offset, CAM_H/2 + y_offset, 0.5, 1, atan2(snapshot->vel_y, snapshot->vel_x), 0.5, 0.5, speed * 48 < 256? speed * 48 : 255); 
             }
         }
 
-        // boost trail 
-        if (game->player.collision_cache[Boost]) {
-            for (int i = 0; i < 8; ++i) {
-                float x_offset = game->player.vel_x * -0.005 * i; 
-                float y_offset = game->player.vel_y * -0.005 * i; 
-                float rot_offset = game->player.rot_vel * -0.025 * i; // do more time back for the ration because it makes the trail look less static and lets the player see the rotation differences 
-                SDL_SetTextureAlphaMod(game->player.texture, 80 - 8 * i);
-                render_texture(renderer, game->player.texture, CAM_W/2.0 + x_offset, CAM_H/2 + y_offset, 0.5, 0.5, game->player.rot + rot_offset, 0.125, 0.25); 
+        // boost trail, fewer copies spread over the same length at lower quality 
+        if (snapshot->on_boost) {
+            int copies = quality->trail_copies; 
+            for (int copy = 0; copy < copies; ++copy) {
+                float i = copy * 8.0 / copies; 
+                float x_offset = snapshot->vel_x * -0.005 * i; 
+                float y_offset = snapshot->vel_y * -0.005 * i; 
+                float rot_offset = snapshot->rot_vel * -0.025 * i; // do more time back for the ration because it makes the trail look less static and lets the player see the rotation differences 
+                render_texture(queue, SpriteLayer, game->player.texture, CAM_W/2.0 + x_offset, CAM_H/2 + y_offset, 0.5, 0.5, snapshot->rot + rot_offset, 0.125, 0.25, 80 - 8 * i); 
             }
-            SDL_SetTextureAlphaMod(game->player.texture, 255);
         }
     }
 
     // explosion particles 
-    if (game->player.state == Exploding) {
-        render_particles(renderer, game->player.explosion_particles, 64, game->player.x, game->player.y); 
+    if (snapshot->state == Exploding) {
+        render_particles(queue, &snapshot->particles, ExplosionEmitter, snapshot->x, snapshot->y); 
     }
 }
 
 
+// SIMULATION THREAD 
+// the game steps at a fixed rate on its own thread, so a slow present or vsync never delays the physics, and the replays get the same step every frame 
+#define SIM_RATE 120 
+#define SIM_MAX_STEPS 8 // steps taken in one go before giving up on catching up (after the thread was not scheduled for a while) 
+
+int run_game_thread(void *data) {
+    struct Game *game = data; 
+    // step times are kept as a whole number of steps from a base so they never drift, each step covers the SDL_GetTicks time up to its own 
+    Uint32 base_time = SDL_GetTicks(); 
+    unsigned long num_steps = 1; 
+    unsigned controls = 0; 
+
+    while (SDL_AtomicGet(&game->running)) {
+        // nothing more is simulated once a transition is asked for, the app stops the thread before it touches the game 
+        int steps = 0; 
+        while (steps < SIM_MAX_STEPS && SDL_AtomicGet(&game->next_state) == InGame) {
+            Uint32 now = SDL_GetTicks(); 
+            Uint32 step_time = base_time + (Uint32)(num_steps * 1000 / SIM_RATE); 
+            if (!SDL_TICKS_PASSED(now, step_time)) break; 
+
+            Uint64 input_counter = take_input(&game->inputs, step_time, &controls); 
+            game->player.left_thruster_control = controls & 1; 
+            game->player.right_thruster_control = (controls & 2) != 0; 
+
+            enum AppState next_state = InGame; 
+            update_game(game, 1.0 / SIM_RATE, &next_state); 
+            if (next_state != InGame) SDL_AtomicSet(&game->next_state, next_state); 
+
+            if (input_counter != 0) {
+                game->input_counter = input_counter; 
+                game->step_counter = SDL_GetPerformanceCounter(); 
+            }
+
+            ++num_steps; 
+            ++steps; 
+        }
+        // drop the time that could not be caught up 
+        if (steps == SIM_MAX_STEPS) {
+            base_time = SDL_GetTicks(); 
+            num_steps = 1; 
+        }
+        if (steps > 0) publish_game_snapshot(game); 
+        SDL_Delay(1); 
+    }
+    return 0; 
+}
+
+// the game must be entered (or paused and coming back) first 
+void start_game_thread(struct Game *game) {
+    SDL_AtomicSet(&game->running, 1); 
+    init_input_queue(&game->inputs); 
+    SDL_AtomicSet(&game->next_state, InGame); 
+    game->thread = SDL_CreateThread(run_game_thread, "simulation", game); 
+}
+
+// after this the game is only touched by the app's thread again 
+void stop_game_thread(struct Game *game) {
+    SDL_AtomicSet(&game->running, 0); 
+    SDL_WaitThread(game->thread, NULL); 
+}
+
+// passes on a state change the simulation asked for 
+void update_game_thread(struct Game *game, enum AppState *next_state) {
+    enum AppState requested = SDL_AtomicGet(&game->next_state); 
+    if (requested != InGame) *next_state = requested; 
+}
+
+// events SDL made itself have no timestamp 
+void set_game_controls(struct Game *game, Uint32 time, unsigned controls) {
+    queue_input(&game->inputs, time != 0? time: SDL_GetTicks(), controls); 
+}
+
+void set_game_control(struct Game *game, Uint32 time, unsigned bit, int on) {
+    unsigned controls = game->inputs.controls; 
+    set_game_controls(game, time, on? controls | bit: controls & ~bit); 
+}
+
+
 void handle_game_event(struct Game *game, SDL_Event *event, enum AppState *next_state) {
+    // the live player belongs to the simulation thread, so the state comes from the newest snapshot 
+    int playing = read_snapshot(&game->snapshots)->state == Playing; 
+
     if (event->type == SDL_KEYDOWN) {
         // left and right keys 
-        if (event->key.keysym.sym == SDLK_LEFT) game->player.left_thruster_control = 1; 
-        else if (event->key.keysym.sym == SDLK_RIGHT) game->player.right_thruster_control = 1; 
+        if (event->key.keysym.sym == SDLK_LEFT) set_game_control(game, event->key.timestamp, 1, 1); 
+        else if (event->key.keysym.sym == SDLK_RIGHT) set_game_control(game, event->key.timestamp, 2, 1); 
         
         // pause screen 
-        else if (event->key.keysym.sym == SDLK_ESCAPE && game->player.state == Playing) {
+        else if (event->key.keysym.sym == SDLK_ESCAPE && playing) {
             *next_state = InOverlay; 
             // turn both of the thruster controls off
-            game->player.left_thruster_control = 0; 
-            game->player.right_thruster_control = 0; 
+            set_game_controls(game, event->key.timestamp, 0); 
         }
     }
     else if (event->type == SDL_KEYUP) {
-        if (event->key.keysym.sym == SDLK_LEFT) game->player.left_thruster_control = 0; 
-        else if (event->key.keysym.sym == SDLK_RIGHT) game->player.right_thruster_control = 0; 
+        if (event->key.keysym.sym == SDLK_LEFT) set_game_control(game, event->key.timestamp, 1, 0); 
+        else if (event->key.keysym.sym == SDLK_RIGHT) set_game_control(game, event->key.timestamp, 2, 0); 
+    }
+
+    // nothing is drawn while the window is minimized or hidden, so pause instead of playing blind 
+    else if (event->type == SDL_WINDOWEVENT && (event->window.event == SDL_WINDOWEVENT_MINIMIZED || event->window.event == SDL_WINDOWEVENT_HIDDEN) && playing) {
+        *next_state = InOverlay; 
+        set_game_controls(game, event->window.timestamp, 0); 
     }
 }
 
+#endif
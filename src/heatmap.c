@@ -0,0 +1,245 @@
+/*
+Offline death heatmap tool. Reads attempt logs written by the telemetry thread, builds per level death and visit histograms over the 48x32 map,
+and writes them out as PNG heatmaps on top of the menu preview art plus a compact binary for the editor.
+
+usage: ./bin/heatmap [output dir] [log files...]   (defaults to heatmaps and levels/attempts.dat)
+
+The logs are mmapped and each thread gets its own slice of records and its own histograms, which are merged once every thread is done.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "lib.c"
+#include "telemetry.c"
+
+#define MAX_THREADS 64
+#define HEATMAP_SCALE 8 // pixels per tile in the pngs
+
+struct LevelHeat {
+    unsigned level_type; 
+    unsigned level_id; 
+    // this is also the layout of the binary file (after the type and id), so keep it flat
+    unsigned attempts; 
+    unsigned deaths[MAP_H][MAP_W]; 
+    unsigned visits[MAP_H][MAP_W]; 
+}; 
+
+struct HeatTable {
+    struct LevelHeat *levels; 
+    unsigned num_levels; 
+    unsigned capacity; 
+    unsigned last_i; // attempts for the same level tend to come in runs, so check the last hit first
+}; 
+
+struct HeatJob {
+    struct Attempt *attempts; 
+    size_t num_attempts; 
+    struct HeatTable table; 
+}; 
+
+struct LevelHeat *get_level_heat(struct HeatTable *table, unsigned level_type, unsigned level_id) {
+    if (table->last_i < table->num_levels && table->levels[table->last_i].level_type == level_type && table->levels[table->last_i].level_id == level_id) {
+        return &table->levels[table->last_i]; 
+    }
+    for (unsigned i = 0; i < table->num_levels; ++i) {
+        if (table->levels[i].level_type == level_type && table->levels[i].level_id == level_id) {
+            table->last_i = i; 
+            return &table->levels[i]; 
+        }
+    }
+
+    // new level, so grow if needed and zero it
+    if (table->num_levels == table->capacity) {
+        table->capacity = table->capacity ? table->capacity * 2: 16; 
+        table->levels = realloc(table->levels, table->capacity * sizeof(struct LevelHeat)); 
+    }
+    struct LevelHeat *heat = &table->levels[table->num_levels]; 
+    memset(heat, 0, sizeof(*heat)); 
+    heat->level_type = level_type; 
+    heat->level_id = level_id; 
+    table->last_i = table->num_levels++; 
+    return heat; 
+}
+
+int run_heat_job(void *data) {
+    struct HeatJob *job = data; 
+    for (size_t i = 0; i < job->num_attempts; ++i) {
+        struct Attempt *attempt = &job->attempts[i]; 
+        struct LevelHeat *heat = get_level_heat(&job->table, attempt->level_type, attempt->level_id); 
+        ++heat->attempts; 
+
+        if (attempt->death_row >= 0 && attempt->death_row < MAP_H && attempt->death_col >= 0 && attempt->death_col < MAP_W) {
+            ++heat->deaths[attempt->death_row][attempt->death_col]; 
+        }
+
+        // visited cells are a bitset, most bytes are empty so skip those whole
+        for (int row = 0; row < MAP_H; ++row) {
+            for (int byte = 0; byte < MAP_W/8; ++byte) {
+                unsigned char bits = attempt->visited[row][byte]; 
+                while (bits) {
+                    int bit = 0; 
+                    while (!(bits & (1 << bit))) ++bit; 
+                    ++heat->visits[row][byte * 8 + bit]; 
+                    bits &= bits - 1; 
+                }
+            }
+        }
+    }
+    return 0; 
+}
+
+void merge_heat_table(struct HeatTable *into, struct HeatTable *from) {
+    for (unsigned i = 0; i < from->num_levels; ++i) {
+        struct LevelHeat *src = &from->levels[i]; 
+        struct LevelHeat *dst = get_level_heat(into, src->level_type, src->level_id); 
+        dst->attempts += src->attempts; 
+        for (int row = 0; row < MAP_H; ++row) {
+            for (int col = 0; col < MAP_W; ++col) {
+                dst->deaths[row][col] += src->deaths[row][col]; 
+                dst->visits[row][col] += src->visits[row][col]; 
+            }
+        }
+    }
+}
+
+void process_log(char *path, struct HeatTable *total, int num_threads) {
+    int fd = open(path, O_RDONLY); 
+    if (fd < 0) {
+        fprintf(stderr, "could not open %s\n", path); 
+        return; 
+    }
+    struct stat info; 
+    fstat(fd, &info); 
+    size_t num_attempts = info.st_size / sizeof(struct Attempt); 
+    if (num_attempts == 0) {
+        close(fd); 
+        return; 
+    }
+
+    struct Attempt *attempts = mmap(NULL, num_attempts * sizeof(struct Attempt), PROT_READ, MAP_PRIVATE, fd, 0); 
+    close(fd); 
+    if (attempts == MAP_FAILED) {
+        fprintf(stderr, "could not map %s\n", path); 
+        return; 
+    }
+
+    // split the records into one contiguous slice per thread
+    struct HeatJob jobs[MAX_THREADS]; 
+    SDL_Thread *threads[MAX_THREADS]; 
+    size_t per_thread = (num_attempts + num_threads - 1) / num_threads; 
+    for (int i = 0; i < num_threads; ++i) {
+        size_t start = i * per_thread < num_attempts? i * per_thread: num_attempts; 
+        size_t end = start + per_thread < num_attempts? start + per_thread: num_attempts; 
+        jobs[i].attempts = attempts + start; 
+        jobs[i].num_attempts = end - start; 
+        jobs[i].table = (struct HeatTable){NULL, 0, 0, 0}; 
+        threads[i] = SDL_CreateThread(run_heat_job, "heat", &jobs[i]); 
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        SDL_WaitThread(threads[i], NULL); 
+        merge_heat_table(total, &jobs[i].table); 
+        free(jobs[i].table.levels); 
+    }
+
+    munmap(attempts, num_attempts * sizeof(struct Attempt)); 
+    printf("%s: %zu attempts\n", path, num_attempts); 
+}
+
+// writes a scaled up preview of the level with the histogram blended on top in the given color
+void save_heatmap_png(char *path, unsigned char map[MAP_H][MAP_W], float spawn_x, float spawn_y, unsigned counts[MAP_H][MAP_W], SDL_Color color) {
+    SDL_Surface *base = SDL_CreateRGBSurfaceWithFormat(0, MAP_W, MAP_H, 32, SDL_PIXELFORMAT_RGBA8888); 
+    fill_preview_pixels(base->pixels, base->pitch, map, spawn_x, spawn_y); 
+
+    unsigned max = 0; 
+    for (int row = 0; row < MAP_H; ++row) {
+        for (int col = 0; col < MAP_W; ++col) {
+            if (counts[row][col] > max) max = counts[row][col]; 
+        }
+    }
+
+    SDL_Surface *image = SDL_CreateRGBSurfaceWithFormat(0, MAP_W * HEATMAP_SCALE, MAP_H * HEATMAP_SCALE, 32, SDL_PIXELFORMAT_RGBA8888); 
+    for (int row = 0; row < MAP_H; ++row) {
+        Uint32 *base_row = (Uint32*)((Uint8*)base->pixels + (MAP_H - 1 - row) * base->pitch); 
+        for (int col = 0; col < MAP_W; ++col) {
+            Uint8 r, g, b, a; 
+            SDL_GetRGBA(base_row[col], base->format, &r, &g, &b, &a); 
+            if (a == 0) r = g = b = 0; // empty tiles are transparent in the menu, but the heatmap wants a solid background
+
+            // square root so a few hot cells do not wash out everything else
+            float t = max? sqrtf((float)counts[row][col] / max): 0; 
+            Uint32 pixel = SDL_MapRGBA(image->format, r + (color.r - r) * t, g + (color.g - g) * t, b + (color.b - b) * t, 255); 
+            SDL_FillRect(image, &(SDL_Rect){col * HEATMAP_SCALE, (MAP_H - 1 - row) * HEATMAP_SCALE, HEATMAP_SCALE, HEATMAP_SCALE}, pixel); 
+        }
+    }
+
+    IMG_SavePNG(image, path); 
+    SDL_FreeSurface(image); 
+    SDL_FreeSurface(base); 
+}
+
+void save_level_heat(struct LevelHeat *heat, char *out_dir) {
+    char *type_name = heat->level_type == OfficialLevel ? "official" : "custom"; 
+
+    // the map comes from the level file if it still exists, otherwise just show the heat on an empty map
+    unsigned char map[MAP_H][MAP_W] = {0}; 
+    float spawn_x = 0.5, spawn_y = 0.5; 
+    char path[256]; 
+    sprintf(path, "levels/%s/%u.lvl", type_name, heat->level_id); 
+    FILE *file = fopen(path, "rb"); 
+    if (file != NULL) {
+        fseek(file, 32 * sizeof(char), SEEK_SET); // skip name
+        fread(&spawn_x, sizeof(float), 1, file); 
+        fread(&spawn_y, sizeof(float), 1, file); 
+        fseek(file, 2 * sizeof(float), SEEK_CUR); // skip rotation and record
+        fread(map, sizeof(map), 1, file); 
+        fclose(file); 
+    }
+
+    snprintf(path, sizeof(path), "%s/%s_%u_deaths.png", out_dir, type_name, heat->level_id); 
+    save_heatmap_png(path, map, spawn_x, spawn_y, heat->deaths, (SDL_Color){255, 0, 0, 255}); 
+    snprintf(path, sizeof(path), "%s/%s_%u_visits.png", out_dir, type_name, heat->level_id); 
+    save_heatmap_png(path, map, spawn_x, spawn_y, heat->visits, (SDL_Color){0, 180, 180, 255}); 
+
+    // compact binary: attempts, then deaths, then visits
+    snprintf(path, sizeof(path), "%s/%s_%u.heat", out_dir, type_name, heat->level_id); 
+    FILE *out = fopen(path, "wb"); 
+    if (out == NULL) {
+        fprintf(stderr, "could not write %s\n", path); 
+        return; 
+    }
+    fwrite(&heat->attempts, sizeof(unsigned), 1, out); 
+    fwrite(heat->deaths, sizeof(heat->deaths), 1, out); 
+    fwrite(heat->visits, sizeof(heat->visits), 1, out); 
+    fclose(out); 
+}
+
+int main(int argc, char *argv[]) {
+    char *out_dir = argc > 1 ? argv[1]: "heatmaps"; 
+    mkdir(out_dir, 0755); 
+
+    int num_threads = SDL_GetCPUCount(); 
+    if (num_threads < 1) num_threads = 1; 
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS; 
+
+    struct HeatTable total = {NULL, 0, 0, 0}; 
+    if (argc > 2) {
+        for (int i = 2; i < argc; ++i) process_log(argv[i], &total, num_threads); 
+    }
+    else process_log(TELEMETRY_PATH, &total, num_threads); 
+
+    for (unsigned i = 0; i < total.num_levels; ++i) save_level_heat(&total.levels[i], out_dir); 
+    printf("wrote heatmaps for %u levels to %s\n", total.num_levels, out_dir); 
+
+    free(total.levels); 
+    return EXIT_SUCCESS; 
+}
@@ -0,0 +1,108 @@
+/*
+Input to photon latency measurement, turned on with latency=on in the settings. Every thruster press or release is followed from the time SDL
+stamped on its event, through the simulation step that took it and the render_game that first drew that step, to the SDL_RenderPresent after it.
+Each stage goes into a histogram, which is drawn over the game and written out as text on exit, to tune vsync, the renderer and the threading with.
+SDL2 stamps an event when the app pumps it, once a frame, not when the key went down, so the first stage starts at the poll and both it and the
+end to end time leave out the wait for the poll, up to a frame (16.7 ms at 60 Hz). They are labelled from the poll to say so.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "lib.c"
+
+#ifndef LATENCY_C
+#define LATENCY_C
+
+#define LATENCY_PATH "latency.txt"
+#define LATENCY_BUCKET_MS 0.5
+#define LATENCY_BUCKETS 200 // up to 100 ms, anything later goes in the last bucket
+
+enum LatencyStage {InputToStep, StepToRender, RenderToPresent, InputToPresent, NUM_LATENCY_STAGES}; 
+char *latency_stage_names[NUM_LATENCY_STAGES] = {"poll to step", "step to render", "render to present", "poll to present"}; 
+
+struct Latency {
+    unsigned counts[NUM_LATENCY_STAGES][LATENCY_BUCKETS]; 
+    unsigned num_samples; 
+    Uint64 last_input; // the same snapshot is drawn for several frames, so each input is only counted the first time
+    char lines[NUM_LATENCY_STAGES][64]; // the text drawn over the game, only remade when a sample comes in
+}; 
+
+void init_latency(struct Latency *latency) {
+    memset(latency, 0, sizeof(*latency)); 
+}
+
+// the upper edge of the bucket the given fraction of the samples are in or under, in ms
+float get_latency_percentile(struct Latency *latency, enum LatencyStage stage, float fraction) {
+    unsigned needed = fraction * latency->num_samples, total = 0; 
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        total += latency->counts[stage][i]; 
+        if (total > needed) return (i + 1) * LATENCY_BUCKET_MS; 
+    }
+    return LATENCY_BUCKETS * LATENCY_BUCKET_MS; 
+}
+
+// the performance counter times of an input and of each stage after it
+void record_latency(struct Latency *latency, Uint64 input, Uint64 step, Uint64 render, Uint64 present) {
+    if (input == 0 || input == latency->last_input) return; 
+    latency->last_input = input; 
+
+    Uint64 times[NUM_LATENCY_STAGES][2] = {{input, step}, {step, render}, {render, present}, {input, present}}; 
+    float frequency = SDL_GetPerformanceFrequency(); 
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) {
+        // the input time comes from a millisecond timestamp, so it can land a little after the step
+        float ms = times[stage][1] > times[stage][0]? (times[stage][1] - times[stage][0]) * 1000 / frequency: 0; 
+        int bucket = ms / LATENCY_BUCKET_MS; 
+        ++latency->counts[stage][bucket < LATENCY_BUCKETS? bucket: LATENCY_BUCKETS - 1]; 
+    }
+    ++latency->num_samples; 
+
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) {
+        snprintf(latency->lines[stage], sizeof(latency->lines[stage]), "%s %.1f %.1f %.1f ms", latency_stage_names[stage],
+            get_latency_percentile(latency, stage, 0.5), get_latency_percentile(latency, stage, 0.9), get_latency_percentile(latency, stage, 0.99)); 
+    }
+}
+
+// the 50th, 90th and 99th percentiles of every stage down the left, and the end to end histogram along the bottom
+void render_latency(struct Latency *latency, struct RenderQueue *queue, struct Glyphs *glyphs) {
+    SDL_Rect viewport = queue->viewport; 
+    char header[64]; 
+    snprintf(header, sizeof(header), "latency p50 p90 p99, %u inputs, from the poll", latency->num_samples); 
+    render_glyph_text(queue, glyphs, header, MENU_CYAN, 8, 0, 0.5, Left); 
+    if (latency->num_samples == 0) return; 
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) {
+        render_glyph_text(queue, glyphs, latency->lines[stage], MENU_CYAN, 9 + stage, 0, 0.5, Left); 
+    }
+
+    unsigned *counts = latency->counts[InputToPresent], max_count = 1; 
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) if (counts[i] > max_count) max_count = counts[i]; 
+    float bar_w = viewport.w / 2.0 / LATENCY_BUCKETS, graph_h = viewport.h / 6.0; 
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        if (counts[i] == 0) continue; 
+        int bar_h = counts[i] * graph_h / max_count + 1; 
+        queue_fill_rect(queue, TextLayer, (SDL_Rect){viewport.w / 2.0 + i * bar_w, viewport.h - bar_h, bar_w + 1, bar_h}, MENU_CYAN); 
+    }
+}
+
+// the percentiles, then every bucket with its count for each stage
+void save_latency(struct Latency *latency, char *path) {
+    if (latency->num_samples == 0) return; 
+    FILE *file = fopen(path, "w"); 
+    if (file == NULL) return; 
+
+    fprintf(file, "# %u inputs, %.1f ms buckets, timed from the frame's event poll not the key press (up to a frame early)\n", latency->num_samples, LATENCY_BUCKET_MS); 
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) fprintf(file, "# %s\n", latency->lines[stage]); 
+    fprintf(file, "ms"); 
+    for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) fprintf(file, ",%s", latency_stage_names[stage]); 
+    fprintf(file, "\n"); 
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        fprintf(file, "%.1f", i * LATENCY_BUCKET_MS); 
+        for (int stage = 0; stage < NUM_LATENCY_STAGES; ++stage) fprintf(file, ",%u", latency->counts[stage][i]); 
+        fprintf(file, "\n"); 
+    }
+    fclose(file); 
+}
+
+#endif
@@ -5,8 +5,12 @@ All components include this, there are many constants and enum definitions as we
 
 #include <stdlib.h> 
 #include <stdio.h> 
+#include <string.h> 
 #include <SDL.h> 
+#include <SDL_image.h> 
 #include <SDL_ttf.h> 
+#include <time.h> 
+#include <sys/stat.h> 
 
 
 #ifndef LIB_C
@@ -42,6 +46,266 @@ enum Tile {
 }; 
 
 
+// BATCHING
+// quads that share a texture are gathered into one vertex buffer and drawn with a single SDL_RenderGeometry call instead of one copy or fill each 
+// batches just live on the stack of whatever is drawing (so the threaded offline tools can batch too), and flush themselves when full 
+#define BATCH_QUADS 512 
+
+struct Batch {
+    SDL_Renderer *renderer; 
+    SDL_Texture *texture; // NULL for plain colored rects 
+    int texture_w, texture_h; 
+    int num_quads; 
+    SDL_Vertex vertices[BATCH_QUADS * 4]; 
+    int indices[BATCH_QUADS * 6]; 
+}; 
+
+void init_batch(struct Batch *batch, SDL_Renderer *renderer, SDL_Texture *texture) {
+    batch->renderer = renderer; 
+    batch->texture = texture; 
+    batch->texture_w = 1; batch->texture_h = 1; 
+    if (texture != NULL) SDL_QueryTexture(texture, NULL, NULL, &batch->texture_w, &batch->texture_h); 
+    batch->num_quads = 0; 
+}
+
+void flush_batch(struct Batch *batch) {
+    if (batch->num_quads > 0) SDL_RenderGeometry(batch->renderer, batch->texture, batch->vertices, batch->num_quads * 4, batch->indices, batch->num_quads * 6); 
+    batch->num_quads = 0; 
+}
+
+// corners go top left, top right, bottom right, bottom left of the src 
+void batch_corners(struct Batch *batch, SDL_Rect *src, SDL_FPoint corners[4], SDL_Color color) {
+    if (batch->num_quads == BATCH_QUADS) flush_batch(batch); 
+
+    float u0 = 0, v0 = 0, u1 = 1, v1 = 1; 
+    if (src != NULL) {
+        u0 = (float)src->x / batch->texture_w; u1 = (float)(src->x + src->w) / batch->texture_w; 
+        v0 = (float)src->y / batch->texture_h; v1 = (float)(src->y + src->h) / batch->texture_h; 
+    }
+
+    int first = batch->num_quads * 4; 
+    SDL_Vertex *vertex = &batch->vertices[first]; 
+    vertex[0] = (SDL_Vertex){corners[0], color, {u0, v0}}; 
+    vertex[1] = (SDL_Vertex){corners[1], color, {u1, v0}}; 
+    vertex[2] = (SDL_Vertex){corners[2], color, {u1, v1}}; 
+    vertex[3] = (SDL_Vertex){corners[3], color, {u0, v1}}; 
+
+    // two triangles, top right and bottom left 
+    int *index = &batch->indices[batch->num_quads * 6]; 
+    index[0] = first; index[1] = first + 1; index[2] = first + 2; 
+    index[3] = first; index[4] = first + 2; index[5] = first + 3; 
+    ++batch->num_quads; 
+}
+
+// src is in texture pixels (NULL for the whole texture) and is ignored by colored batches, color modulates the texture like the vertex color does 
+void batch_quad(struct Batch *batch, SDL_Rect *src, SDL_FRect dst, SDL_Color color) {
+    batch_corners(batch, src, (SDL_FPoint[4]){{dst.x, dst.y}, {dst.x + dst.w, dst.y}, {dst.x + dst.w, dst.y + dst.h}, {dst.x, dst.y + dst.h}}, color); 
+}
+
+// the same as SDL_RenderCopyEx: angle is in degrees clockwise, around center (relative to the top left of dst) 
+void batch_rotated_quad(struct Batch *batch, SDL_Rect *src, SDL_FRect dst, float angle, SDL_FPoint center, SDL_Color color) {
+    float c = cosf(angle * M_PI/180), s = sinf(angle * M_PI/180); 
+    float pivot_x = dst.x + center.x, pivot_y = dst.y + center.y; 
+    SDL_FPoint corners[4] = {{-center.x, -center.y}, {dst.w - center.x, -center.y}, {dst.w - center.x, dst.h - center.y}, {-center.x, dst.h - center.y}}; 
+    for (int i = 0; i < 4; ++i) {
+        float x = corners[i].x, y = corners[i].y; 
+        corners[i] = (SDL_FPoint){pivot_x + x * c - y * s, pivot_y + x * s + y * c}; 
+    }
+    batch_corners(batch, src, corners, color); 
+}
+
+#define BATCH_WHITE ((SDL_Color){255, 255, 255, 255}) 
+
+
+
+// RENDER QUEUE 
+// the render functions push what they draw into the queue instead of drawing it, and submit_render_queue draws all of it in one pass, sorted by 
+// layer and then by texture, so each texture is one batch per layer however the drawing code interleaves them. Colors and alpha are in the vertices, 
+// so there are no draw color or texture mod changes either, and the viewport is read once when the queue begins instead of by every primitive 
+// only draws in the same layer get reordered (and never two with the same texture), so anything that has to be over a different texture goes in a higher layer 
+#define MAX_RENDER_COMMANDS 4096 
+
+enum RenderLayer {GroundLayer, ParticleLayer, SpriteLayer, EffectLayer, TextLayer, OutlineLayer}; 
+
+struct RenderCommand {
+    unsigned char layer; 
+    unsigned order; // when it was pushed, so draws with the same layer and texture stay in order 
+    SDL_Texture *texture; // NULL for a filled rect 
+    SDL_Rect src; // w of 0 for the whole texture 
+    SDL_FRect dst; 
+    float angle; // like SDL_RenderCopyEx, degrees clockwise around center (relative to dst) 
+    SDL_FPoint center; 
+    SDL_Color color; 
+}; 
+
+struct RenderQueue {
+    SDL_Renderer *renderer; 
+    SDL_Rect viewport; // of the current target, read by begin_render_queue 
+    struct RenderCommand *commands; 
+    unsigned num_commands; 
+    unsigned long num_draws, num_quads; // totals over every submit, only read by the benchmark 
+}; 
+
+void init_render_queue(struct RenderQueue *queue, SDL_Renderer *renderer) {
+    queue->renderer = renderer; 
+    queue->commands = malloc(MAX_RENDER_COMMANDS * sizeof(struct RenderCommand)); 
+    queue->num_commands = 0; 
+    queue->num_draws = queue->num_quads = 0; 
+    SDL_RenderGetViewport(renderer, &queue->viewport); 
+}
+
+void cleanup_render_queue(struct RenderQueue *queue) {
+    free(queue->commands); 
+}
+
+// call whenever the target or viewport changes, before pushing anything for it 
+void begin_render_queue(struct RenderQueue *queue) {
+    queue->num_commands = 0; 
+    SDL_RenderGetViewport(queue->renderer, &queue->viewport); 
+}
+
+int compare_render_commands(const void *a, const void *b) {
+    const struct RenderCommand *first = a, *second = b; 
+    if (first->layer != second->layer) return first->layer < second->layer? -1: 1; 
+    if (first->texture != second->texture) return (uintptr_t)first->texture < (uintptr_t)second->texture? -1: 1; 
+    return first->order < second->order? -1: first->order > second->order; 
+}
+
+// draws everything pushed so far and empties the queue, the queued textures have to still exist until this 
+void submit_render_queue(struct RenderQueue *queue) {
+    qsort(queue->commands, queue->num_commands, sizeof(struct RenderCommand), compare_render_commands); 
+
+    struct Batch batch; 
+    init_batch(&batch, queue->renderer, NULL); 
+    for (unsigned i = 0; i < queue->num_commands; ++i) {
+        struct RenderCommand *command = &queue->commands[i]; 
+        if (i == 0 || command->texture != batch.texture) {
+            queue->num_draws += batch.num_quads > 0; 
+            flush_batch(&batch); 
+            init_batch(&batch, queue->renderer, command->texture); 
+        }
+        SDL_Rect *src = command->src.w > 0? &command->src: NULL; 
+        if (command->angle != 0) batch_rotated_quad(&batch, src, command->dst, command->angle, command->center, command->color); 
+        else batch_quad(&batch, src, command->dst, command->color); 
+    }
+    queue->num_draws += batch.num_quads > 0; 
+    flush_batch(&batch); 
+    queue->num_quads += queue->num_commands; 
+    queue->num_commands = 0; 
+}
+
+void queue_rotated_quad(struct RenderQueue *queue, enum RenderLayer layer, SDL_Texture *texture, SDL_Rect *src, SDL_FRect dst, float angle, SDL_FPoint center, SDL_Color color) {
+    if (queue->num_commands == MAX_RENDER_COMMANDS) submit_render_queue(queue); // keeps the order right for everything but the sorting across the split 
+    queue->commands[queue->num_commands] = (struct RenderCommand){layer, queue->num_commands, texture, src != NULL? *src: (SDL_Rect){0, 0, 0, 0}, dst, angle, center, color}; 
+    ++queue->num_commands; 
+}
+
+void queue_quad(struct RenderQueue *queue, enum RenderLayer layer, SDL_Texture *texture, SDL_Rect *src, SDL_FRect dst, SDL_Color color) {
+    queue_rotated_quad(queue, layer, texture, src, dst, 0, (SDL_FPoint){0, 0}, color); 
+}
+
+void queue_fill_rect(struct RenderQueue *queue, enum RenderLayer layer, SDL_Rect rect, SDL_Color color) {
+    queue_quad(queue, layer, NULL, NULL, (SDL_FRect){rect.x, rect.y, rect.w, rect.h}, color); 
+}
+
+
+
+// QUALITY GOVERNOR 
+// the optional work (particle emission, the boost trail, the drag creasent and the resolution the game is drawn at) is scaled by a quality level 
+// that follows the measured frame time: it drops quickly when frames run over the budget and climbs back slowly when there is room to spare 
+#define DEFAULT_TARGET_FPS 60 
+#define GOVERNOR_SMOOTHING 0.1 // weight of each new frame in the average 
+#define GOVERNOR_DROP_LOAD 0.8 // fraction of the budget the average can reach before quality drops 
+#define GOVERNOR_RAISE_LOAD 0.4 // and has to stay under before it goes back up 
+#define GOVERNOR_DROP_DELAY 0.5 // seconds over (or under) the limit before a change, and then again before the next one 
+#define GOVERNOR_RAISE_DELAY 3.0 
+
+struct Quality {
+    float particle_rate; // multiplies the emission rates 
+    int trail_copies; // ship copies in the boost trail 
+    float render_scale; // of the game's resolution 
+    int effects; // the drag creasent 
+}; 
+
+// lowest first, a level only gives up the next cheapest thing so the drop is hard to notice 
+#define NUM_QUALITY_LEVELS 5 
+struct Quality quality_levels[NUM_QUALITY_LEVELS] = {
+    {0.25, 2, 0.5, 0},
+    {0.5, 4, 0.7, 0},
+    {0.5, 4, 0.85, 1},
+    {0.75, 6, 1, 1},
+    {1, 8, 1, 1},
+}; 
+
+struct Governor {
+    float budget; // seconds per frame at the target rate 
+    float average; // smoothed frame time 
+    float over_time, under_time; // how long the average has been over the drop limit or under the raise limit 
+    int level; 
+}; 
+
+void init_governor(struct Governor *governor, int target_fps) {
+    governor->budget = 1.0 / (target_fps > 0? target_fps: DEFAULT_TARGET_FPS); 
+    governor->average = 0; 
+    governor->over_time = governor->under_time = 0; 
+    governor->level = NUM_QUALITY_LEVELS - 1; // start at full and let slow machines find their level 
+}
+
+// frame_time is the work of one frame, and delta_time the time since the last one (what the delays count in) 
+void update_governor(struct Governor *governor, float frame_time, float delta_time) {
+    governor->average = governor->average? governor->average + (frame_time - governor->average) * GOVERNOR_SMOOTHING: frame_time; 
+
+    governor->over_time = governor->average > governor->budget * GOVERNOR_DROP_LOAD? governor->over_time + delta_time: 0; 
+    governor->under_time = governor->average < governor->budget * GOVERNOR_RAISE_LOAD? governor->under_time + delta_time: 0; 
+
+    if (governor->over_time > GOVERNOR_DROP_DELAY && governor->level > 0) {
+        --governor->level; 
+        governor->over_time = 0; 
+    }
+    else if (governor->under_time > GOVERNOR_RAISE_DELAY && governor->level < NUM_QUALITY_LEVELS - 1) {
+        ++governor->level; 
+        governor->under_time = 0; 
+    }
+}
+
+struct Quality *get_quality(struct Governor *governor) {
+    return &quality_levels[governor->level]; 
+}
+
+
+
+// RENDERER DRIVERS 
+// index of the SDL render driver with the given name (software, opengl, opengles2, direct3d11, metal...), -1 lets SDL pick 
+int find_render_driver(char *name) {
+    SDL_RendererInfo info; 
+    for (int i = 0; i < SDL_GetNumRenderDrivers(); ++i) {
+        if (SDL_GetRenderDriverInfo(i, &info) == 0 && strcmp(info.name, name) == 0) return i; 
+    }
+    return -1; 
+}
+
+// if the driver cannot be made on this machine this falls back to SDL's pick, so a settings file copied between machines still runs 
+SDL_Renderer *create_renderer(SDL_Window *window, int driver, int vsync) {
+    SDL_RendererInfo info; 
+    int software = driver >= 0 && SDL_GetRenderDriverInfo(driver, &info) == 0 && strcmp(info.name, "software") == 0; 
+    Uint32 flags = (software? SDL_RENDERER_SOFTWARE: SDL_RENDERER_ACCELERATED) | (vsync? SDL_RENDERER_PRESENTVSYNC: 0); 
+
+    SDL_Renderer *renderer = SDL_CreateRenderer(window, driver, flags); 
+    if (renderer == NULL && driver >= 0) {
+        fprintf(stderr, "could not create the renderer (%s), using the default\n", SDL_GetError()); 
+        renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (vsync? SDL_RENDERER_PRESENTVSYNC: 0)); 
+    }
+    return renderer; 
+}
+
+
+
+
+
+
+
+
+
 // TEXT AND TILES
 
 void init_text(SDL_Texture **texture, char *string, TTF_Font *font, SDL_Color color, SDL_Renderer *renderer) {
@@ -52,13 +316,18 @@ void init_text(SDL_Texture **texture, char *string, TTF_Font *font, SDL_Color co
 }
 
 enum TextAnchor {Left, Middle, Right}; 
-void render_menu_text(SDL_Renderer *renderer, SDL_Texture *texture, unsigned row, float col, float height, enum TextAnchor anchor) {
+// src picks part of the texture (like an icon out of the icon atlas), NULL for all of it 
+void render_menu_sprite(struct RenderQueue *queue, SDL_Texture *texture, SDL_Rect *src, unsigned row, float col, float height, enum TextAnchor anchor) {
+    if (texture == NULL) return; // a NULL texture in the queue would be a filled rect 
+
     // render by in the corrrect aspect ratio 
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
+    SDL_Rect viewport = queue->viewport; 
 
     int tw, th; 
-    SDL_QueryTexture(texture, NULL, NULL, &tw, &th); 
+    if (src != NULL) {
+        tw = src->w; th = src->h; 
+    }
+    else SDL_QueryTexture(texture, NULL, NULL, &tw, &th); 
 
     int display_h = height/UI_H * viewport.h; 
     int display_w = display_h * ((float)tw / th);
@@ -66,19 +335,109 @@ void render_menu_text(SDL_Renderer *renderer, SDL_Texture *texture, unsigned row
     int edge_spacing = 0.125/UI_W * viewport.w; 
 
     int x_offset = (anchor == Right)? display_w + edge_spacing: (anchor == Middle)? display_w/2 : -edge_spacing; 
-    SDL_RenderCopy(renderer, texture, NULL, &(SDL_Rect){(float)col/UI_W * viewport.w - x_offset, ((row + 0.5)/UI_H) * viewport.h - display_h/2.0, display_w, display_h}); 
+    SDL_Rect dst = {(float)col/UI_W * viewport.w - x_offset, ((row + 0.5)/UI_H) * viewport.h - display_h/2.0, display_w, display_h}; 
+    queue_quad(queue, TextLayer, texture, src, (SDL_FRect){dst.x, dst.y, dst.w, dst.h}, BATCH_WHITE); 
+}
+
+void render_menu_text(struct RenderQueue *queue, SDL_Texture *texture, unsigned row, float col, float height, enum TextAnchor anchor) {
+    render_menu_sprite(queue, texture, NULL, row, col, height, anchor); 
+}
+
+// text that changes every frame or keystroke (the timer, a name being typed) is drawn from a glyph atlas instead: every printable ascii glyph is 
+// rendered once, so drawing a string is one batch of quads and measuring one is just adding up the advances, without rendering or making any textures 
+#define FIRST_GLYPH ' ' 
+#define NUM_GLYPHS ('~' - ' ' + 1) 
+#define GLYPH_ATLAS_W 1024 
+
+struct Glyphs {
+    SDL_Texture *atlas; 
+    SDL_Rect rects[NUM_GLYPHS]; // each glyph is a full line tall, like a one character string rendered on its own 
+    int advances[NUM_GLYPHS]; 
+    int line_h; 
+}; 
+
+void init_glyphs(struct Glyphs *glyphs, TTF_Font *font, SDL_Renderer *renderer) {
+    glyphs->line_h = TTF_FontHeight(font); 
+
+    // pack left to right in rows, with a pixel between glyphs so filtering does not bleed 
+    SDL_Surface *images[NUM_GLYPHS]; 
+    int x = 0, y = 0, atlas_h = 0; 
+    for (int i = 0; i < NUM_GLYPHS; ++i) {
+        int minx, maxx, miny, maxy; 
+        TTF_GlyphMetrics(font, FIRST_GLYPH + i, &minx, &maxx, &miny, &maxy, &glyphs->advances[i]); 
+        images[i] = TTF_RenderGlyph_Blended(font, FIRST_GLYPH + i, (SDL_Color){255, 255, 255, 255}); // white so the vertex color can tint it 
+        int w = images[i] != NULL? images[i]->w: 0, h = images[i] != NULL? images[i]->h: 0; 
+        if (x + w > GLYPH_ATLAS_W) {
+            x = 0; 
+            y = atlas_h + 1; 
+        }
+        glyphs->rects[i] = (SDL_Rect){x, y, w, h}; 
+        x += w + 1; 
+        if (y + h > atlas_h) atlas_h = y + h; 
+    }
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, GLYPH_ATLAS_W, atlas_h > 0? atlas_h: 1, 32, SDL_PIXELFORMAT_RGBA32); 
+    for (int i = 0; i < NUM_GLYPHS; ++i) {
+        if (images[i] == NULL) continue; 
+        SDL_Rect dst = glyphs->rects[i]; // blitting clips the rect it is given 
+        SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE); 
+        SDL_BlitSurface(images[i], NULL, atlas, &dst); 
+        SDL_FreeSurface(images[i]); 
+    }
+    glyphs->atlas = SDL_CreateTextureFromSurface(renderer, atlas); 
+    SDL_FreeSurface(atlas); 
+    SDL_SetTextureScaleMode(glyphs->atlas, SDL_ScaleModeLinear); 
 }
 
-void render_menu_tile(SDL_Renderer *renderer, SDL_Texture *tiles, enum MenuTile tile, unsigned row, unsigned col) {
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
-    SDL_RenderCopy(renderer, tiles, &(SDL_Rect){tile * 16, 0, 16, 16}, &(SDL_Rect){(float)col/UI_W * viewport.w, (float)row/UI_H * viewport.h, 1.0/UI_W * viewport.w + 1, 1.0/UI_H * viewport.h + 1}); 
+void cleanup_glyphs(struct Glyphs *glyphs) {
+    SDL_DestroyTexture(glyphs->atlas); 
 }
 
-void render_menu_outline(SDL_Renderer *renderer, unsigned row, unsigned col, unsigned width, unsigned height) {
+// width of the string in font pixels (the same units as line_h), characters outside of printable ascii take no space 
+int measure_glyph_text(struct Glyphs *glyphs, char *string) {
+    int width = 0; 
+    for (char *c = string; *c; ++c) {
+        if (*c >= FIRST_GLYPH && *c < FIRST_GLYPH + NUM_GLYPHS) width += glyphs->advances[*c - FIRST_GLYPH]; 
+    }
+    return width; 
+}
+
+// same placement as render_menu_text, so glyph text and texture text line up 
+void render_glyph_text(struct RenderQueue *queue, struct Glyphs *glyphs, char *string, SDL_Color color, unsigned row, float col, float height, enum TextAnchor anchor) {
+    SDL_Rect viewport = queue->viewport; 
+
+    int display_h = height/UI_H * viewport.h; 
+    float scale = (float)display_h / glyphs->line_h; 
+    int display_w = measure_glyph_text(glyphs, string) * scale; 
+
+    int edge_spacing = 0.125/UI_W * viewport.w; 
+
+    int x_offset = (anchor == Right)? display_w + edge_spacing: (anchor == Middle)? display_w/2 : -edge_spacing; 
+    float x = (float)col/UI_W * viewport.w - x_offset, y = ((row + 0.5)/UI_H) * viewport.h - display_h/2.0; 
+
+    for (char *c = string; *c; ++c) {
+        if (*c < FIRST_GLYPH || *c >= FIRST_GLYPH + NUM_GLYPHS) continue; 
+        SDL_Rect *src = &glyphs->rects[*c - FIRST_GLYPH]; 
+        if (src->w > 0) queue_quad(queue, TextLayer, glyphs->atlas, src, (SDL_FRect){x, y, src->w * scale, src->h * scale}, color); 
+        x += glyphs->advances[*c - FIRST_GLYPH] * scale; 
+    }
+}
+
+// one grid tile out of the menu tiles, under everything else 
+void render_menu_tile(struct RenderQueue *queue, SDL_Texture *tiles, enum MenuTile tile, unsigned row, unsigned col) {
+    // truncate to whole pixels like a copy with an int rect would 
+    SDL_Rect viewport = queue->viewport; 
+    SDL_Rect dst = {(float)col/UI_W * viewport.w, (float)row/UI_H * viewport.h, 1.0/UI_W * viewport.w + 1, 1.0/UI_H * viewport.h + 1}; 
+    queue_quad(queue, GroundLayer, tiles, &(SDL_Rect){tile * 16, 0, 16, 16}, (SDL_FRect){dst.x, dst.y, dst.w, dst.h}, BATCH_WHITE); 
+}
+
+// the outline colors, for hovering something enabled or disabled 
+#define MENU_CYAN ((SDL_Color){0, 180, 180, 255}) 
+#define MENU_RED ((SDL_Color){180, 0, 0, 255}) 
+
+void render_menu_outline(struct RenderQueue *queue, unsigned row, unsigned col, unsigned width, unsigned height, SDL_Color color) {
     // outline around a menu tile 
-    SDL_Rect viewport; 
-    SDL_RenderGetViewport(renderer, &viewport); 
+    SDL_Rect viewport = queue->viewport; 
 
     int thickness = 0.05/UI_W * viewport.w; 
     int p_width = (float)width/UI_W * viewport.w; 
@@ -89,25 +448,22 @@ void render_menu_outline(SDL_Renderer *renderer, unsigned row, unsigned col, uns
 
 
     // left
-    SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y, thickness, p_height}); 
+    queue_fill_rect(queue, OutlineLayer, (SDL_Rect){p_x, p_y, thickness, p_height}, color); 
     // right
-    SDL_RenderFillRect(renderer, &(SDL_Rect){p_x + p_width - thickness, p_y, thickness, p_height}); 
+    queue_fill_rect(queue, OutlineLayer, (SDL_Rect){p_x + p_width - thickness, p_y, thickness, p_height}, color); 
     // top 
-    SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y, p_width, thickness}); 
+    queue_fill_rect(queue, OutlineLayer, (SDL_Rect){p_x, p_y, p_width, thickness}, color); 
     // bottom 
-    SDL_RenderFillRect(renderer, &(SDL_Rect){p_x, p_y + p_height - thickness, p_width, thickness}); 
+    queue_fill_rect(queue, OutlineLayer, (SDL_Rect){p_x, p_y + p_height - thickness, p_width, thickness}, color); 
 }
 
-void render_background(SDL_Renderer *renderer, SDL_Texture *tiles, int mouse_row, int mouse_col) {
-    // render all the blank tiles in the background
+void render_background(struct RenderQueue *queue, SDL_Texture *tiles) {
+    // render all the blank tiles in the background 
     for (int row = 0; row < UI_H; ++row) {
         for (int col = 0; col < UI_W; ++col) {
-            render_menu_tile(renderer, tiles, Blank, row, col); 
+            render_menu_tile(queue, tiles, Blank, row, col); 
         }
     }
-    
-    SDL_SetRenderDrawColor(renderer, 180,  0, 0, 255); 
-    render_menu_outline(renderer, mouse_row, mouse_col, 1, 1); 
 }
 
 void get_mouse_coords(int mx, int my, SDL_Renderer *renderer, unsigned *row, unsigned *col) {
@@ -123,11 +479,106 @@ void get_mouse_coords(int mx, int my, SDL_Renderer *renderer, unsigned *row, uns
 
 
 
+// ASSETS 
+// every image is loaded once and shared by whoever asks for it, counting its users so it is only destroyed when the last one lets go 
+// the button icons are all the same size, so they are packed side by side into one texture and drawn by their rect in it 
+#define MAX_ASSETS 8 
+#define ICON_GUTTER 2 // empty pixels around each icon so linear filtering never picks up a neighbour 
+
+enum Icon {ExitIcon, PlayIcon, ImportIcon, ExportIcon, LeftIcon, RightIcon, EditIcon, DeleteIcon, RenameIcon, PlaceSpawnIcon, RotateSpawnIcon, NUM_ICONS}; 
+
+struct Assets {
+    struct Asset {
+        char path[64]; 
+        SDL_Texture *texture; 
+        unsigned users; 
+    } loaded[MAX_ASSETS]; 
+    unsigned num_loaded; 
+
+    SDL_Texture *icons; 
+    SDL_Rect icon_rects[NUM_ICONS]; 
+}; 
+
+void init_assets(struct Assets *assets, SDL_Renderer *renderer) {
+    assets->num_loaded = 0; 
+
+    // same order as enum Icon 
+    char *icon_paths[NUM_ICONS] = {
+        "assets/exit.png", "assets/play.png", "assets/import.png", "assets/export.png", "assets/left.png", "assets/right.png", 
+        "assets/edit.png", "assets/delete.png", "assets/rename.png", "assets/place_spawn.png", "assets/rotate_spawn.png"
+    }; 
+    SDL_Surface *images[NUM_ICONS]; 
+    int atlas_w = ICON_GUTTER, atlas_h = 0; 
+    for (int i = 0; i < NUM_ICONS; ++i) {
+        images[i] = IMG_Load(icon_paths[i]); 
+        int w = images[i] != NULL? images[i]->w: 0, h = images[i] != NULL? images[i]->h: 0; 
+        assets->icon_rects[i] = (SDL_Rect){atlas_w, ICON_GUTTER, w, h}; 
+        atlas_w += w + ICON_GUTTER; 
+        if (h + 2 * ICON_GUTTER > atlas_h) atlas_h = h + 2 * ICON_GUTTER; 
+    }
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, atlas_w, atlas_h, 32, SDL_PIXELFORMAT_RGBA32); 
+    for (int i = 0; i < NUM_ICONS; ++i) {
+        if (images[i] == NULL) continue; 
+        SDL_SetSurfaceBlendMode(images[i], SDL_BLENDMODE_NONE); // copy the alpha as it is instead of blending onto the empty atlas 
+        SDL_BlitSurface(images[i], NULL, atlas, &assets->icon_rects[i]); 
+        SDL_FreeSurface(images[i]); 
+    }
+    assets->icons = SDL_CreateTextureFromSurface(renderer, atlas); 
+    SDL_FreeSurface(atlas); 
+    SDL_SetTextureScaleMode(assets->icons, SDL_ScaleModeLinear); 
+}
+
+void cleanup_assets(struct Assets *assets) {
+    SDL_DestroyTexture(assets->icons); 
+    // anything still loaded was never released, but it all goes with the renderer anyway 
+    for (unsigned i = 0; i < assets->num_loaded; ++i) SDL_DestroyTexture(assets->loaded[i].texture); 
+    assets->num_loaded = 0; 
+}
+
+SDL_Texture *load_asset(struct Assets *assets, SDL_Renderer *renderer, char *path) {
+    for (unsigned i = 0; i < assets->num_loaded; ++i) {
+        if (strcmp(assets->loaded[i].path, path) == 0) {
+            ++assets->loaded[i].users; 
+            return assets->loaded[i].texture; 
+        }
+    }
+    if (assets->num_loaded == MAX_ASSETS) return IMG_LoadTexture(renderer, path); // should never happen, but still works (just without sharing) 
+
+    struct Asset *asset = &assets->loaded[assets->num_loaded++]; 
+    snprintf(asset->path, sizeof(asset->path), "%s", path); 
+    asset->texture = IMG_LoadTexture(renderer, path); 
+    asset->users = 1; 
+    return asset->texture; 
+}
+
+void release_asset(struct Assets *assets, SDL_Texture *texture) {
+    for (unsigned i = 0; i < assets->num_loaded; ++i) {
+        if (assets->loaded[i].texture == texture) {
+            if (--assets->loaded[i].users == 0) {
+                SDL_DestroyTexture(texture); 
+                assets->loaded[i] = assets->loaded[--assets->num_loaded]; 
+            }
+            return; 
+        }
+    }
+    SDL_DestroyTexture(texture); // one that did not fit in the cache 
+}
+
+
+
+
+
+
+
+
+
 // BUTTONS 
 struct Button {
     unsigned row, col; 
     unsigned width; 
     SDL_Texture *text; 
+    SDL_Rect *text_src; // where the icon is in the icon atlas, NULL when the text is its own texture 
     int enabled; 
 }; 
 
@@ -141,35 +592,34 @@ void init_button(struct Button *button, unsigned row, unsigned col, unsigned wid
     button->width = width; 
     // use the text functionality 
     init_text(&button->text, text_str, font, (SDL_Color){0, 180, 180, 255}, renderer); 
+    button->text_src = NULL; 
     button->enabled = 1; 
 }
-// special button who's text is not basic ascii from the font, so the text texture is passed in directly 
-void init_special_text_button(struct Button *button, unsigned row, unsigned col, unsigned width, SDL_Texture *text) {
-    SDL_SetTextureScaleMode(text, SDL_ScaleModeLinear);
-
+// special button who's text is not basic ascii from the font, so it shows an icon out of the shared icon atlas instead (not owned by the button) 
+void init_icon_button(struct Button *button, unsigned row, unsigned col, unsigned width, struct Assets *assets, enum Icon icon) {
     button->row = row; 
     button->col = col; 
     button->width = width; 
-    button->text = text; 
+    button->text = assets->icons; 
+    button->text_src = &assets->icon_rects[icon]; 
     button->enabled = 1; 
 }
 
-void render_button(struct Button *button, SDL_Renderer *renderer, SDL_Texture *tiles, int mouse_row, int mouse_col) {
+void render_button(struct Button *button, struct RenderQueue *queue, SDL_Texture *tiles, int mouse_row, int mouse_col) {
     // render the background tiles, then the text, and then the possible outline 
 
     // background tiles
     enum MenuTile bg = button->enabled? Enabled : Disabled; 
     for (unsigned col = button->col; col < button->col + button->width; ++col) {
-        render_menu_tile(renderer, tiles, bg, button->row, col); 
+        render_menu_tile(queue, tiles, bg, button->row, col); 
     }
 
     // text
-    render_menu_text(renderer, button->text, button->row, button->col + button->width/2.0, 0.9, Middle); 
+    render_menu_sprite(queue, button->text, button->text_src, button->row, button->col + button->width/2.0, 0.9, Middle); 
 
     // outline
     if (is_mouse_over_button(button, mouse_row, mouse_col)) {
-        button->enabled? SDL_SetRenderDrawColor(renderer, 0,  180, 180, 255): SDL_SetRenderDrawColor(renderer, 180,  0, 0, 255); 
-        render_menu_outline(renderer, button->row, button->col, button->width, 1); 
+        render_menu_outline(queue, button->row, button->col, button->width, 1, button->enabled? MENU_CYAN: MENU_RED); 
     }
 }
 
@@ -181,114 +631,636 @@ void render_button(struct Button *button, SDL_Renderer *renderer, SDL_Texture *t
 
 
 
-// LEVEL PREVIEWS (More specific button used by the level select menus)
-struct LevelPreview {
-    SDL_Texture *name; 
-    SDL_Texture *record; 
-    SDL_Texture *map; 
+// MAP TILES 
+// the force and torque tiles are in the high res atlas (64px), everything else is in the low res one (16px)
+int is_high_res_tile(unsigned char tile) {
+    return tile >= DownForce && tile <= ClockwiseTorque; 
+}
+
+SDL_Rect get_tile_src(unsigned char tile) {
+    return is_high_res_tile(tile)? (SDL_Rect){(tile - DownForce) * 64, 0, 64, 64}: (SDL_Rect){tile * 16, 0, 16, 16}; 
+}
+
+// draws the whole map into dst (row 0 at the bottom like in game), used wherever the full level needs to be drawn at once 
+void render_level_map(SDL_Renderer *renderer, SDL_Texture *low_res_tiles, SDL_Texture *high_res_tiles, unsigned char map[MAP_H][MAP_W], SDL_Rect dst) {
+    // tiles never overlap, so each atlas can go in its own batch without changing the result 
+    struct Batch low_batch, high_batch; 
+    init_batch(&low_batch, renderer, low_res_tiles); 
+    init_batch(&high_batch, renderer, high_res_tiles); 
+    for (int row = 0; row < MAP_H; ++row) {
+        // compute both edges of each tile so neighbouring tiles always meet exactly 
+        int top = dst.y + (MAP_H - 1 - row) * dst.h / MAP_H, bottom = dst.y + (MAP_H - row) * dst.h / MAP_H; 
+        for (int col = 0; col < MAP_W; ++col) {
+            int left = dst.x + col * dst.w / MAP_W, right = dst.x + (col + 1) * dst.w / MAP_W; 
+            SDL_Rect src = get_tile_src(map[row][col]); 
+            batch_quad(is_high_res_tile(map[row][col])? &high_batch: &low_batch, &src, (SDL_FRect){left, top, right - left, bottom - top}, BATCH_WHITE); 
+        }
+    }
+    flush_batch(&low_batch); 
+    flush_batch(&high_batch); 
+}
+
+
+// GLOW LIGHTMAP 
+// the gravity, antigravity, win and force tiles light up the tiles around them. The light is worked out once on the cpu when a level is loaded 
+// (a separable blur of the glowing tiles, split over a few threads) into a texture, which is then added over the map wherever it was pre-rendered, 
+// so none of it costs anything per frame. The editor only blurs again around the cells it paints 
+#define GLOW_TEXELS_PER_TILE 4 
+#define GLOW_RADIUS 2 // in tiles, the grid also reaches this far past the map so the light spills onto the walls around it 
+#define GLOW_KERNEL (GLOW_RADIUS * GLOW_TEXELS_PER_TILE) // texels on each side of the blur 
+#define GLOW_W ((MAP_W + 2 * GLOW_RADIUS) * GLOW_TEXELS_PER_TILE) 
+#define GLOW_H ((MAP_H + 2 * GLOW_RADIUS) * GLOW_TEXELS_PER_TILE) 
+#define GLOW_STRENGTH 2.5 
+#define GLOW_MAX_THREADS 8 
+
+struct Glow {
+    // rgb floats for every texel, the texture's top row first 
+    float *light; // just the glowing tiles 
+    float *rows; // after the horizontal pass 
+    Uint8 *pixels; // after both passes, as rgba for the texture 
+    float kernel[2 * GLOW_KERNEL + 1]; 
+    SDL_Rect dirty; // texels changed since the texture was last updated, empty when w is 0 
 }; 
 
+// black for the tiles that do not glow 
+SDL_Color get_glow_color(unsigned char tile) {
+    if (tile == Win) return (SDL_Color){0, 200, 80, 255}; 
+    else if (tile == Gravity) return (SDL_Color){150, 60, 220, 255}; 
+    else if (tile == AntiGravity) return (SDL_Color){230, 140, 40, 255}; 
+    else if (tile >= DownForce && tile <= RightForce) return (SDL_Color){123, 226, 237, 255}; 
+    return (SDL_Color){0, 0, 0, 255}; 
+}
 
-int get_mouse_preview_i(int mrow, int mcol) {
-    // get the index of the preview given the position on the menu screen
-    if (1 <= mcol % 8 && mcol % 8 <= 6 && 1 <= (mrow - 1) % 6)  {
-        int grid_row = mrow / 7, grid_col = mcol/8; 
-        int i = grid_row * 3 + grid_col; 
-        return i; 
+void init_glow(struct Glow *glow) {
+    glow->light = calloc(GLOW_W * GLOW_H * 3, sizeof(float)); 
+    glow->rows = calloc(GLOW_W * GLOW_H * 3, sizeof(float)); 
+    glow->pixels = calloc(GLOW_W * GLOW_H * 4, sizeof(Uint8)); 
+    glow->dirty = (SDL_Rect){0, 0, 0, 0}; 
+
+    // a gaussian with the radius at two standard deviations 
+    float sigma = GLOW_KERNEL / 2.0, total = 0; 
+    for (int i = -GLOW_KERNEL; i <= GLOW_KERNEL; ++i) total += glow->kernel[i + GLOW_KERNEL] = expf(-i * i / (2 * sigma * sigma)); 
+    for (int i = 0; i <= 2 * GLOW_KERNEL; ++i) glow->kernel[i] /= total; 
+}
+
+void cleanup_glow(struct Glow *glow) {
+    free(glow->pixels); 
+    free(glow->rows); 
+    free(glow->light); 
+}
+
+// the texels of a range of tiles (rows and columns are inclusive, row 0 at the bottom like in game) 
+SDL_Rect get_glow_rect(int row0, int col0, int row1, int col1) {
+    return (SDL_Rect){(col0 + GLOW_RADIUS) * GLOW_TEXELS_PER_TILE, (MAP_H + GLOW_RADIUS - 1 - row1) * GLOW_TEXELS_PER_TILE, 
+        (col1 - col0 + 1) * GLOW_TEXELS_PER_TILE, (row1 - row0 + 1) * GLOW_TEXELS_PER_TILE}; 
+}
+
+// sets the light of a range of tiles from the map, returns 1 if any of it changed 
+int set_glow_tiles(struct Glow *glow, unsigned char map[MAP_H][MAP_W], int row0, int col0, int row1, int col1) {
+    int changed = 0; 
+    for (int row = row0; row <= row1; ++row) {
+        for (int col = col0; col <= col1; ++col) {
+            SDL_Color color = get_glow_color(map[row][col]); 
+            float light[3] = {color.r / 255.0f, color.g / 255.0f, color.b / 255.0f}; 
+            SDL_Rect rect = get_glow_rect(row, col, row, col); 
+            for (int y = rect.y; y < rect.y + rect.h; ++y) {
+                float *texel = &glow->light[(y * GLOW_W + rect.x) * 3]; 
+                changed |= memcmp(texel, light, sizeof(light)) != 0; 
+                for (int x = 0; x < rect.w; ++x, texel += 3) memcpy(texel, light, sizeof(light)); 
+            }
+        }
     }
-    else return -1; 
+    return changed; 
+}
 
+// horizontal pass over the texels in [x0, x1) and [y0, y1), texels past the edge of the grid count as dark 
+void blur_glow_rows(struct Glow *glow, int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            float sum[3] = {0, 0, 0}; 
+            int start = x - GLOW_KERNEL < 0? -x: -GLOW_KERNEL, end = x + GLOW_KERNEL >= GLOW_W? GLOW_W - 1 - x: GLOW_KERNEL; 
+            for (int i = start; i <= end; ++i) {
+                float *texel = &glow->light[(y * GLOW_W + x + i) * 3], weight = glow->kernel[i + GLOW_KERNEL]; 
+                sum[0] += texel[0] * weight; sum[1] += texel[1] * weight; sum[2] += texel[2] * weight; 
+            }
+            memcpy(&glow->rows[(y * GLOW_W + x) * 3], sum, sizeof(sum)); 
+        }
+    }
 }
 
-void init_preview(struct LevelPreview *preview, TTF_Font *font, SDL_Renderer *renderer, char *path) {
-    // initialize the preview, including its text, record, and map preview 
-    FILE *file = fopen(path, "rb"); 
-    
+// vertical pass over the horizontal one, straight into the pixels 
+void blur_glow_columns(struct Glow *glow, int x0, int y0, int x1, int y1) {
+    for (int y = y0; y < y1; ++y) {
+        int start = y - GLOW_KERNEL < 0? -y: -GLOW_KERNEL, end = y + GLOW_KERNEL >= GLOW_H? GLOW_H - 1 - y: GLOW_KERNEL; 
+        for (int x = x0; x < x1; ++x) {
+            float sum[3] = {0, 0, 0}; 
+            for (int i = start; i <= end; ++i) {
+                float *texel = &glow->rows[((y + i) * GLOW_W + x) * 3], weight = glow->kernel[i + GLOW_KERNEL]; 
+                sum[0] += texel[0] * weight; sum[1] += texel[1] * weight; sum[2] += texel[2] * weight; 
+            }
+            Uint8 *pixel = &glow->pixels[(y * GLOW_W + x) * 4]; 
+            for (int c = 0; c < 3; ++c) pixel[c] = sum[c] * GLOW_STRENGTH >= 1? 255: sum[c] * GLOW_STRENGTH * 255; 
+            pixel[3] = 255; 
+        }
+    }
+}
+
+// one band of texel rows (or columns) of one pass, for a thread 
+struct GlowJob {
+    struct Glow *glow; 
+    int columns; 
+    int start, end; 
+}; 
+
+int run_glow_job(void *data) {
+    struct GlowJob *job = data; 
+    if (job->columns) blur_glow_columns(job->glow, job->start, 0, job->end, GLOW_H); 
+    else blur_glow_rows(job->glow, 0, job->start, GLOW_W, job->end); 
+    return 0; 
+}
+
+// adds a rect to the part of the texture that needs updating 
+void mark_glow_dirty(struct Glow *glow, SDL_Rect rect) {
+    if (glow->dirty.w == 0) glow->dirty = rect; 
+    else SDL_UnionRect(&glow->dirty, &rect, &glow->dirty); 
+}
+
+// the whole map, with each pass split into bands over the cpus (the vertical pass needs all of the horizontal one, so the threads are joined between) 
+void bake_glow(struct Glow *glow, unsigned char map[MAP_H][MAP_W]) {
+    set_glow_tiles(glow, map, 0, 0, MAP_H - 1, MAP_W - 1); 
+
+    int num_threads = SDL_GetCPUCount(); 
+    if (num_threads < 1) num_threads = 1; 
+    if (num_threads > GLOW_MAX_THREADS) num_threads = GLOW_MAX_THREADS; 
+    struct GlowJob jobs[GLOW_MAX_THREADS]; 
+    SDL_Thread *threads[GLOW_MAX_THREADS]; 
+    for (int columns = 0; columns <= 1; ++columns) {
+        int size = columns? GLOW_W: GLOW_H; 
+        for (int i = 0; i < num_threads; ++i) {
+            jobs[i] = (struct GlowJob){glow, columns, size * i / num_threads, size * (i + 1) / num_threads}; 
+            // the calling thread takes the last band itself, and any thread that cannot be made 
+            threads[i] = i + 1 < num_threads? SDL_CreateThread(run_glow_job, "glow", &jobs[i]): NULL; 
+            if (threads[i] == NULL) run_glow_job(&jobs[i]); 
+        }
+        for (int i = 0; i < num_threads; ++i) if (threads[i] != NULL) SDL_WaitThread(threads[i], NULL); 
+    }
+    mark_glow_dirty(glow, (SDL_Rect){0, 0, GLOW_W, GLOW_H}); 
+}
+
+// blurs again around a range of changed tiles, returns 1 if the light changed (and the tiles within GLOW_RADIUS of the range need redrawing) 
+int update_glow(struct Glow *glow, unsigned char map[MAP_H][MAP_W], int row0, int col0, int row1, int col1) {
+    if (!set_glow_tiles(glow, map, row0, col0, row1, col1)) return 0; 
+
+    // the pixels within the blur of the tiles change, and the horizontal pass is needed for the blur's height again above and below those 
+    SDL_Rect grid = {0, 0, GLOW_W, GLOW_H}, tiles = get_glow_rect(row0, col0, row1, col1), changed, rows; 
+    SDL_Rect blurred = {tiles.x - GLOW_KERNEL, tiles.y - GLOW_KERNEL, tiles.w + 2 * GLOW_KERNEL, tiles.h + 2 * GLOW_KERNEL}; 
+    SDL_IntersectRect(&blurred, &grid, &changed); 
+    SDL_Rect needed = {changed.x, changed.y - GLOW_KERNEL, changed.w, changed.h + 2 * GLOW_KERNEL}; 
+    SDL_IntersectRect(&needed, &grid, &rows); 
+    blur_glow_rows(glow, rows.x, rows.y, rows.x + rows.w, rows.y + rows.h); 
+    blur_glow_columns(glow, changed.x, changed.y, changed.x + changed.w, changed.y + changed.h); 
+    mark_glow_dirty(glow, changed); 
+    return 1; 
+}
+
+// additive and filtered, so it can be stretched over tiles of any size 
+SDL_Texture *create_glow_texture(SDL_Renderer *renderer) {
+    SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, GLOW_W, GLOW_H); 
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_ADD); 
+    SDL_SetTextureScaleMode(texture, SDL_ScaleModeLinear); 
+    return texture; 
+}
+
+// uploads only the dirty part 
+void upload_glow(struct Glow *glow, SDL_Texture *texture) {
+    if (glow->dirty.w == 0) return; 
+    SDL_UpdateTexture(texture, &glow->dirty, &glow->pixels[(glow->dirty.y * GLOW_W + glow->dirty.x) * 4], GLOW_W * 4); 
+    glow->dirty = (SDL_Rect){0, 0, 0, 0}; 
+}
+
+
+
+
+
+
+
+
+// LEVEL PREVIEWS (More specific button used by the level select menus)
+// the map images of the previews live in one atlas texture with a slot per level, and the names and records are drawn from the glyph atlas, so 
+// showing a preview never creates a texture. Slots of levels that were paged away from are kept and reused least recently used first, keyed by the 
+// level and the modification time of its file (editing a level or setting a record rewrites it), so paging back and forth reads no level files either 
+// the files are read on a worker thread, which hands back the finished name, record and pixels, and the main thread only uploads them into the atlas. 
+// Until then a preview is drawn as a placeholder. The menus also ask for the pages on either side, so flipping to one usually finds it ready 
+#define PREVIEW_ATLAS_COLUMNS 8 
+#define PREVIEW_ATLAS_ROWS 4 
+#define PREVIEW_SLOTS (PREVIEW_ATLAS_COLUMNS * PREVIEW_ATLAS_ROWS) // more than the 18 of a page and the two next to it, so the page being shown is never evicted 
+#define PREVIEW_JOBS 64 
+
+struct LevelPreview {
+    int used; 
+    int loaded; // 0 until the worker's result has been taken, drawn as a placeholder until then 
+    unsigned generation; // bumped when the slot goes to another level, so a late result for the old one is thrown away 
+    enum LevelType level_type; 
+    unsigned level_id; 
+    time_t mtime; 
+    unsigned last_used; 
+
     char name[32]; 
-    fread(&name, sizeof(name), 1, file); 
+    char record[8]; // empty if the level has no record 
+    SDL_Rect src; // of the map image in the atlas 
+}; 
 
-    float spawn_x, spawn_y; 
-    fread(&spawn_x, sizeof(float), 1, file);
-    fread(&spawn_y, sizeof(float), 1, file); 
+// a level for the worker to read, or to check if it changed since mtime 
+struct PreviewJob {
+    int slot; 
+    unsigned generation; 
+    enum LevelType level_type; 
+    unsigned level_id; 
+    time_t mtime; // of the version in the slot, 0 to always read it 
+}; 
 
-    fseek(file, sizeof(float), SEEK_CUR); // skip rotation 
-    
-    float record; 
-    fread(&record, sizeof(float), 1, file); 
+struct PreviewResult {
+    int slot; 
+    unsigned generation; 
+    int changed; // 0 if the file still had the mtime of the job, and nothing else is filled in 
+    time_t mtime; 
+    char name[32]; 
+    char record[8]; 
+    Uint32 pixels[MAP_H][MAP_W]; 
+}; 
 
-    unsigned char map[MAP_H][MAP_W]; 
-    fread(&map, sizeof(map), 1, file); 
-    fclose(file); 
+struct PreviewCache {
+    SDL_Texture *atlas; 
+    struct LevelPreview slots[PREVIEW_SLOTS]; 
+    unsigned clock; // counts lookups, for the least recently used order 
+
+    // single producer single consumer rings like the telemetry one: jobs go to the worker, results come back 
+    struct PreviewJob jobs[PREVIEW_JOBS]; 
+    SDL_atomic_t job_write_i, job_read_i; 
+    struct PreviewResult *results; // as many as there are jobs, allocated since they are large 
+    SDL_atomic_t result_write_i, result_read_i; 
+    unsigned num_pending; // jobs whose results have not been taken yet, only touched by the main thread 
+
+    SDL_sem *wake; // posted for every job 
+    SDL_atomic_t running; 
+    SDL_Thread *thread; 
+}; 
 
-    // name 
-    init_text(&preview->name, name, font, (SDL_Color){0, 180, 180, 255}, renderer); 
 
-    // record (if infinity, just set it to be null)
-    if (record != INFINITY) {
-        char record_str[8]; sprintf(record_str, "%.1f", record); 
-        init_text(&preview->record, record_str, font, (SDL_Color){0, 180, 180, 255}, renderer);
+int get_mouse_preview_i(int mrow, int mcol) {
+    // get the index of the preview given the position on the menu screen
+    if (1 <= mcol % 8 && mcol % 8 <= 6 && 1 <= (mrow - 1) % 6)  {
+        int grid_row = mrow / 7, grid_col = mcol/8; 
+        int i = grid_row * 3 + grid_col; 
+        return i; 
     }
-    else preview->record = NULL; 
+    else return -1; 
 
-    // MAP 
-    // create the map preview by creating a texture manually, and then we will render it with the preview  
-    preview->map = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888,SDL_TEXTUREACCESS_STREAMING,MAP_W, MAP_H);
+}
 
+// writes the one pixel per tile preview image (RGBA8888, top row first) into pixels, shared by the menu previews and the offline tools 
+void fill_preview_pixels(void *pixels, int byte_width, unsigned char map[MAP_H][MAP_W], float spawn_x, float spawn_y) {
     SDL_PixelFormat *fmt = SDL_AllocFormat(SDL_PIXELFORMAT_RGBA8888);
     Uint32 purple = SDL_MapRGBA(fmt, 46, 16, 107, 255); 
     Uint32 blue = SDL_MapRGBA(fmt, 0, 180, 180, 255); 
 
-    // code to traverse the texture image using pointer logic 
-    void *start; 
-    int byte_width; 
-    SDL_LockTexture(preview->map, NULL, &start, &byte_width); 
-
     for (int row = 0; row < MAP_H; ++row) {
-        Uint32 *row_ptr = (Uint32*)((Uint8*)start + (MAP_H - 1 - row) * byte_width);      
+        Uint32 *row_ptr = (Uint32*)((Uint8*)pixels + (MAP_H - 1 - row) * byte_width);      
         for (int col = 0; col < MAP_W; ++col) {
             row_ptr[col] = (map[row][col] == Solid || map[row][col] == Gravity || map[row][col] == AntiGravity) ? purple: (map[row][col] == Win)? blue: 0x00000000;
         }
     }
 
-    Uint32 *spawn_row_ptr = (Uint32*)((Uint8*)start + (MAP_H - 1 - (int)spawn_y) * byte_width); 
+    Uint32 *spawn_row_ptr = (Uint32*)((Uint8*)pixels + (MAP_H - 1 - (int)spawn_y) * byte_width); 
     spawn_row_ptr[(int)spawn_x] = blue; 
 
     SDL_FreeFormat(fmt);
-    SDL_UnlockTexture(preview->map); 
 }
 
-void cleanup_previews(struct LevelPreview previews[]) {
-    for (int i = 0; i < 6; ++i) {
-        SDL_DestroyTexture(previews[i].name); 
-        SDL_DestroyTexture(previews[i].record); 
-        SDL_DestroyTexture(previews[i].map); 
+// reads the level (on the worker thread), unless the file still has the mtime of the job 
+void read_preview(struct PreviewJob *job, struct PreviewResult *result) {
+    char path[32]; 
+    sprintf(path, "levels/%s/%u.lvl", job->level_type == OfficialLevel ? "official" : "custom", job->level_id); 
+    struct stat info; 
+    result->mtime = stat(path, &info) == 0? info.st_mtime: 0; 
+    result->changed = job->mtime == 0 || result->mtime != job->mtime; 
+    if (!result->changed) return; 
+
+    // a level that is gone shows up empty 
+    char name[32] = {0}; 
+    float spawn_x = 0, spawn_y = 0, record = INFINITY; 
+    unsigned char map[MAP_H][MAP_W] = {0}; 
+    FILE *file = fopen(path, "rb"); 
+    if (file != NULL) {
+        fread(&name, sizeof(name), 1, file); 
+        fread(&spawn_x, sizeof(float), 1, file);
+        fread(&spawn_y, sizeof(float), 1, file); 
+        fseek(file, sizeof(float), SEEK_CUR); // skip rotation 
+        fread(&record, sizeof(float), 1, file); 
+        fread(&map, sizeof(map), 1, file); 
+        fclose(file); 
+    }
+
+    memcpy(result->name, name, sizeof(result->name)); 
+    result->name[sizeof(result->name) - 1] = '\0'; 
+    // record (if infinity, there is none to show) 
+    if (record != INFINITY) snprintf(result->record, sizeof(result->record), "%.1f", record); 
+    else result->record[0] = '\0'; 
+    fill_preview_pixels(result->pixels, sizeof(result->pixels[0]), map, spawn_x, spawn_y); 
+}
+
+int run_preview_worker(void *data) {
+    struct PreviewCache *cache = data; 
+    while (SDL_AtomicGet(&cache->running)) {
+        SDL_SemWait(cache->wake); 
+
+        // the main thread never has more jobs out than there are results, so there is always room for one 
+        unsigned read_i = SDL_AtomicGet(&cache->job_read_i); 
+        while (read_i != (unsigned)SDL_AtomicGet(&cache->job_write_i)) {
+            struct PreviewJob *job = &cache->jobs[read_i % PREVIEW_JOBS]; 
+            unsigned result_i = SDL_AtomicGet(&cache->result_write_i); 
+            struct PreviewResult *result = &cache->results[result_i % PREVIEW_JOBS]; 
+            result->slot = job->slot; 
+            result->generation = job->generation; 
+            read_preview(job, result); 
+
+            SDL_AtomicSet(&cache->job_read_i, ++read_i); 
+            SDL_AtomicSet(&cache->result_write_i, result_i + 1); 
+        }
+    }
+    return 0; 
+}
+
+void init_preview_cache(struct PreviewCache *cache, SDL_Renderer *renderer) {
+    cache->atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, PREVIEW_ATLAS_COLUMNS * MAP_W, PREVIEW_ATLAS_ROWS * MAP_H); 
+    for (int i = 0; i < PREVIEW_SLOTS; ++i) {
+        cache->slots[i].used = 0; 
+        cache->slots[i].generation = 0; 
+        cache->slots[i].src = (SDL_Rect){(i % PREVIEW_ATLAS_COLUMNS) * MAP_W, (i / PREVIEW_ATLAS_COLUMNS) * MAP_H, MAP_W, MAP_H}; 
     }
+    cache->clock = 0; 
+
+    SDL_AtomicSet(&cache->job_write_i, 0); 
+    SDL_AtomicSet(&cache->job_read_i, 0); 
+    cache->results = malloc(PREVIEW_JOBS * sizeof(struct PreviewResult)); 
+    SDL_AtomicSet(&cache->result_write_i, 0); 
+    SDL_AtomicSet(&cache->result_read_i, 0); 
+    cache->num_pending = 0; 
+
+    cache->wake = SDL_CreateSemaphore(0); 
+    SDL_AtomicSet(&cache->running, 1); 
+    cache->thread = SDL_CreateThread(run_preview_worker, "previews", cache); 
+}
+
+void cleanup_preview_cache(struct PreviewCache *cache) {
+    SDL_AtomicSet(&cache->running, 0); 
+    SDL_SemPost(cache->wake); 
+    SDL_WaitThread(cache->thread, NULL); 
+    SDL_DestroySemaphore(cache->wake); 
+    free(cache->results); 
+    SDL_DestroyTexture(cache->atlas); 
+}
+
+// returns 0 if there is no room, there is never more than a page or two of jobs out so that only happens with very fast paging 
+int queue_preview_job(struct PreviewCache *cache, struct LevelPreview *preview, time_t mtime) {
+    if (cache->num_pending == PREVIEW_JOBS) return 0; 
+    unsigned write_i = SDL_AtomicGet(&cache->job_write_i); 
+    cache->jobs[write_i % PREVIEW_JOBS] = (struct PreviewJob){preview - cache->slots, preview->generation, preview->level_type, preview->level_id, mtime}; 
+    SDL_AtomicSet(&cache->job_write_i, write_i + 1); 
+    ++cache->num_pending; 
+    SDL_SemPost(cache->wake); 
+    return 1; 
+}
+
+// uploads a result into its slot, returns 0 if there was nothing to change 
+int apply_preview_result(struct PreviewCache *cache, struct PreviewResult *result) {
+    struct LevelPreview *preview = &cache->slots[result->slot]; 
+    if (result->generation != preview->generation || !result->changed) return 0; 
+    memcpy(preview->name, result->name, sizeof(preview->name)); 
+    memcpy(preview->record, result->record, sizeof(preview->record)); 
+    SDL_UpdateTexture(cache->atlas, &preview->src, result->pixels, sizeof(result->pixels[0])); 
+    preview->mtime = result->mtime; 
+    preview->loaded = 1; 
+    return 1; 
+}
+
+// takes whatever the worker has finished, returns 1 if any preview changed so the menus know to redraw 
+int update_preview_cache(struct PreviewCache *cache) {
+    int changed = 0; 
+    unsigned read_i = SDL_AtomicGet(&cache->result_read_i), write_i = SDL_AtomicGet(&cache->result_write_i); 
+    for (; read_i != write_i; ++read_i) {
+        changed |= apply_preview_result(cache, &cache->results[read_i % PREVIEW_JOBS]); 
+        --cache->num_pending; 
+    }
+    SDL_AtomicSet(&cache->result_read_i, read_i); 
+    return changed; 
+}
+
+// the preview of the level, which may still be loading. A cached one is checked against its file in the background and reloaded if it changed 
+struct LevelPreview *get_preview(struct PreviewCache *cache, enum LevelType level_type, unsigned level_id) {
+    struct LevelPreview *oldest = &cache->slots[0]; 
+    for (int i = 0; i < PREVIEW_SLOTS; ++i) {
+        struct LevelPreview *preview = &cache->slots[i]; 
+        if (preview->used && preview->level_type == level_type && preview->level_id == level_id) {
+            if (preview->loaded) queue_preview_job(cache, preview, preview->mtime); // only a check, so it can be skipped if there is no room 
+            preview->last_used = ++cache->clock; 
+            return preview; 
+        }
+        if (!preview->used || (oldest->used && preview->last_used < oldest->last_used)) oldest = preview; 
+    }
+
+    oldest->used = 1; 
+    oldest->loaded = 0; 
+    ++oldest->generation; 
+    oldest->level_type = level_type; 
+    oldest->level_id = level_id; 
+    oldest->last_used = ++cache->clock; 
+    if (!queue_preview_job(cache, oldest, 0)) {
+        // no room for the job, so read it here like before 
+        struct PreviewJob job = {oldest - cache->slots, oldest->generation, level_type, level_id, 0}; 
+        struct PreviewResult *result = malloc(sizeof(struct PreviewResult)); 
+        result->slot = job.slot; 
+        result->generation = job.generation; 
+        read_preview(&job, result); 
+        apply_preview_result(cache, result); 
+        free(result); 
+    }
+    return oldest; 
+}
+
+// for when the app has just written the level's file: its mtime only has whole seconds, so a write in the same second as the cached read 
+// would look unchanged. A loaded slot keeps showing the old preview until the next get_preview reads the file again, and anything the worker 
+// still has in flight for it (read before the write) is thrown away 
+void invalidate_preview(struct PreviewCache *cache, enum LevelType level_type, unsigned level_id) {
+    for (int i = 0; i < PREVIEW_SLOTS; ++i) {
+        struct LevelPreview *preview = &cache->slots[i]; 
+        if (preview->used && preview->level_type == level_type && preview->level_id == level_id) {
+            ++preview->generation; 
+            preview->mtime = 0; 
+            preview->used = preview->loaded; // one still loading has nothing to show, so it just starts over 
+        }
+    }
+}
+
+// starts on a level that is likely to be shown soon, skipped when the worker already has plenty to do so it never falls back to reading here 
+void prefetch_preview(struct PreviewCache *cache, enum LevelType level_type, unsigned level_id) {
+    if (cache->num_pending < PREVIEW_JOBS / 2) get_preview(cache, level_type, level_id); 
 }
 
 // renders the preview, based on if it is enabled (not stored with the preview since it is grid based)
-void render_preview(struct LevelPreview *preview, int grid_i, SDL_Renderer *renderer, SDL_Texture *tiles, int mouse_row, int mouse_col, int enabled) {
+void render_preview(struct LevelPreview *preview, struct PreviewCache *cache, int grid_i, struct RenderQueue *queue, SDL_Texture *tiles, struct Glyphs *glyphs, int mouse_row, int mouse_col, int enabled) {
     int start_col = 1 + 8 * (grid_i % 3), start_row = 2 + 6 * (grid_i / 3); 
 
     // background 
     enum MenuTile bg = enabled? Enabled : Disabled; 
+    SDL_Rect viewport = queue->viewport; 
     for (int row = start_row; row < start_row + 5; ++row) {
         for (int col = start_col; col < start_col + 6; ++col) {
-            render_menu_tile(renderer, tiles, bg, row, col); 
+            render_menu_tile(queue, tiles, bg, row, col); 
         }
     }
 
-    // name and record 
-    render_menu_text(renderer, preview->name, start_row, start_col, 0.75, Left); 
-    render_menu_text(renderer, preview->record, start_row, start_col + 6, 0.5, Right);
-    
-    
-    SDL_Rect viewport; SDL_RenderGetViewport(renderer, &viewport);
-    SDL_RenderCopy(renderer, preview->map, NULL, &(SDL_Rect){(start_col + 0.5)/UI_W * viewport.w, (start_row + 1 + 0.5 * 2.0/3)/UI_H * viewport.h, 5.0/UI_W * viewport.w, (4 - 2.0/3)/UI_H * viewport.h}); 
+    // name, record and map, or just a placeholder while the level is still being read 
+    if (preview->loaded) {
+        render_glyph_text(queue, glyphs, preview->name, MENU_CYAN, start_row, start_col, 0.75, Left); 
+        render_glyph_text(queue, glyphs, preview->record, MENU_CYAN, start_row, start_col + 6, 0.5, Right);
+
+        SDL_Rect dst = {(start_col + 0.5)/UI_W * viewport.w, (start_row + 1 + 0.5 * 2.0/3)/UI_H * viewport.h, 5.0/UI_W * viewport.w, (4 - 2.0/3)/UI_H * viewport.h}; 
+        queue_quad(queue, SpriteLayer, cache->atlas, &preview->src, (SDL_FRect){dst.x, dst.y, dst.w, dst.h}, BATCH_WHITE); 
+    }
+    else render_glyph_text(queue, glyphs, "...", MENU_CYAN, start_row, start_col, 0.75, Left); 
 
     // outline if needed 
     if (mouse_row >= start_row && mouse_row < start_row + 5 && mouse_col >= start_col && mouse_col < start_col + 6) {
-        enabled? SDL_SetRenderDrawColor(renderer, 0,  180, 180, 255): SDL_SetRenderDrawColor(renderer, 180,  0, 0, 255); 
-        render_menu_outline(renderer, start_row, start_col, 6, 5); 
+        render_menu_outline(queue, start_row, start_col, 6, 5, enabled? MENU_CYAN: MENU_RED); 
+    }
+}
+
+
+
+
+
+
+
+
+
+// MENU LAYERS 
+// everything on a menu screen except the hover outline only changes on entry or a page flip, so it is drawn once into a texture (again only if marked dirty 
+// or the window changes size), and a frame is just one copy of that plus the outline. The layout is also kept as a table of which button or preview is 
+// over each grid cell, so hover and clicks are one lookup instead of checking every button 
+#define MENU_ROWS 14 // UI_H rounded up 
+#define MAX_MENU_REGIONS 24 
+
+struct MenuRegion {
+    unsigned row, col, width, height; 
+    int enabled; 
+    struct Button *button; // NULL for the level previews 
+}; 
+
+struct MenuLayer {
+    SDL_Texture *texture; 
+    SDL_Texture *last_target; // whatever was being drawn to before the layer, and its viewport, put back by end_menu_layer 
+    SDL_Rect last_viewport; 
+    int dirty; 
+    int outline_background; // outline the empty grid cell under the mouse as well (the select screens do, the overlay does not) 
+
+    struct MenuRegion regions[MAX_MENU_REGIONS]; 
+    int num_regions; 
+    signed char cells[MENU_ROWS][UI_W]; // index of the region over each cell, -1 for none 
+}; 
+
+void clear_menu_layer(struct MenuLayer *layer) {
+    layer->num_regions = 0; 
+    memset(layer->cells, -1, sizeof(layer->cells)); 
+    layer->dirty = 1; 
+}
+
+void init_menu_layer(struct MenuLayer *layer, int outline_background) {
+    layer->texture = NULL; 
+    layer->last_target = NULL; 
+    layer->outline_background = outline_background; 
+    clear_menu_layer(layer); 
+}
+
+void cleanup_menu_layer(struct MenuLayer *layer) {
+    SDL_DestroyTexture(layer->texture); 
+}
+
+void add_menu_region(struct MenuLayer *layer, unsigned row, unsigned col, unsigned width, unsigned height, int enabled, struct Button *button) {
+    if (layer->num_regions == MAX_MENU_REGIONS) return; 
+    layer->regions[layer->num_regions] = (struct MenuRegion){row, col, width, height, enabled, button}; 
+    for (unsigned r = row; r < row + height && r < MENU_ROWS; ++r) {
+        for (unsigned c = col; c < col + width && c < UI_W; ++c) layer->cells[r][c] = layer->num_regions; 
+    }
+    ++layer->num_regions; 
+}
+
+void add_menu_button(struct MenuLayer *layer, struct Button *button) {
+    add_menu_region(layer, button->row, button->col, button->width, 1, button->enabled, button); 
+}
+
+// same grid position as render_preview 
+void add_menu_preview(struct MenuLayer *layer, int grid_i, int enabled) {
+    add_menu_region(layer, 2 + 6 * (grid_i / 3), 1 + 8 * (grid_i % 3), 6, 5, enabled, NULL); 
+}
+
+struct MenuRegion *get_menu_region(struct MenuLayer *layer, unsigned row, unsigned col) {
+    if (row >= MENU_ROWS || col >= UI_W || layer->cells[row][col] < 0) return NULL; 
+    return &layer->regions[(int)layer->cells[row][col]]; 
+}
+
+// the button under the grid cell, NULL if it is empty or a preview 
+struct Button *get_menu_button(struct MenuLayer *layer, unsigned row, unsigned col) {
+    struct MenuRegion *region = get_menu_region(layer, row, col); 
+    return region != NULL? region->button: NULL; 
+}
+
+// returns 1 with the queue pointed at the layer if it needs to be drawn, the caller then queues the static parts (with no mouse) and calls end_menu_layer 
+int begin_menu_layer(struct MenuLayer *layer, struct RenderQueue *queue) {
+    SDL_Renderer *renderer = queue->renderer; 
+    SDL_Rect *viewport = &layer->last_viewport; 
+    *viewport = queue->viewport; 
+    int w = 0, h = 0; 
+    if (layer->texture != NULL) SDL_QueryTexture(layer->texture, NULL, NULL, &w, &h); 
+    if (!layer->dirty && w == viewport->w && h == viewport->h) return 0; 
+
+    // anything already queued belongs to the old target 
+    submit_render_queue(queue); 
+
+    if (w != viewport->w || h != viewport->h) {
+        SDL_DestroyTexture(layer->texture); 
+        layer->texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, viewport->w, viewport->h); 
+        SDL_SetTextureBlendMode(layer->texture, SDL_BLENDMODE_BLEND); // keep any see through pixels see through, like drawing straight to the window 
+    }
+    // the full target is the same size as the viewport, so all of the menu math works unchanged 
+    layer->last_target = SDL_GetRenderTarget(renderer); 
+    SDL_SetRenderTarget(renderer, layer->texture); 
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 0); 
+    SDL_RenderClear(renderer); 
+    begin_render_queue(queue); 
+    layer->dirty = 0; 
+    return 1; 
+}
+
+void end_menu_layer(struct MenuLayer *layer, struct RenderQueue *queue) {
+    submit_render_queue(queue); 
+
+    // switching targets resets the viewport, so put the letterboxed one back 
+    SDL_SetRenderTarget(queue->renderer, layer->last_target); 
+    SDL_RenderSetViewport(queue->renderer, &layer->last_viewport); 
+    begin_render_queue(queue); 
+}
+
+void render_menu_layer(struct MenuLayer *layer, struct RenderQueue *queue, unsigned mouse_row, unsigned mouse_col) {
+    queue_quad(queue, GroundLayer, layer->texture, NULL, (SDL_FRect){0, 0, queue->viewport.w, queue->viewport.h}, BATCH_WHITE); 
+
+    // hover outline, the same colors the buttons and previews use 
+    struct MenuRegion *region = get_menu_region(layer, mouse_row, mouse_col); 
+    if (region != NULL) {
+        render_menu_outline(queue, region->row, region->col, region->width, region->height, region->enabled? MENU_CYAN: MENU_RED); 
+    }
+    else if (layer->outline_background) {
+        render_menu_outline(queue, mouse_row, mouse_col, 1, 1, MENU_RED); 
     }
 }
 
@@ -2,22 +2,80 @@
 
 #include <stdlib.h> 
 #include <stdio.h> 
+#include <string.h> 
 #include <SDL.h> 
 #include <SDL_image.h> 
 
 #include "lib.c"
+#include "telemetry.c"
+#include "latency.c"
 #include "official.c"
 #include "custom.c"
 #include "game.c"
 #include "editor.c"
 #include "overlay.c"
 
+#define IDLE_WAIT_MS 1000 // states that do not animate still wake up this often 
+#define SETTINGS_PATH "settings.txt" 
+
+// options read from the settings file, then from the command line (the same key=value form) so either can override 
+struct Settings {
+    int render_w, render_h; // size of the internal frame everything is drawn at, 0 to draw straight to the window at its own size 
+    int linear_upscale; // filter the internal frame when it is stretched to the window, otherwise keep the pixels sharp 
+    int target_fps; // the frame rate the quality governor tries to hold in the game 
+    char renderer[16]; // name of the SDL render driver, empty to let SDL pick 
+    int vsync; 
+    int latency; // measure how long thruster input takes to reach the screen, drawn over the game and saved to latency.txt 
+}; 
+
+void apply_setting(struct Settings *settings, char *line) {
+    char key[32], value[32]; 
+    if (line[0] == '#' || sscanf(line, " %31[^= ] = %31s", key, value) != 2) return; 
+
+    if (strcmp(key, "render_size") == 0) {
+        if (strcmp(value, "native") == 0 || sscanf(value, "%dx%d", &settings->render_w, &settings->render_h) != 2 || settings->render_w <= 0 || settings->render_h <= 0) {
+            settings->render_w = settings->render_h = 0; 
+        }
+    }
+    else if (strcmp(key, "upscale") == 0) settings->linear_upscale = strcmp(value, "linear") == 0; 
+    else if (strcmp(key, "target_fps") == 0) settings->target_fps = atoi(value); 
+    else if (strcmp(key, "renderer") == 0) snprintf(settings->renderer, sizeof(settings->renderer), "%s", strcmp(value, "auto") == 0? "": value); 
+    else if (strcmp(key, "vsync") == 0) settings->vsync = strcmp(value, "on") == 0; 
+    else if (strcmp(key, "latency") == 0) settings->latency = strcmp(value, "on") == 0; 
+}
+
+void load_settings(struct Settings *settings, int argc, char *argv[]) {
+    settings->render_w = settings->render_h = 0; 
+    settings->linear_upscale = 1; 
+    settings->target_fps = DEFAULT_TARGET_FPS; 
+    settings->renderer[0] = '\0'; 
+    settings->vsync = 1; 
+    settings->latency = 0; 
+
+    FILE *file = fopen(SETTINGS_PATH, "r"); 
+    if (file != NULL) {
+        char line[128]; 
+        while (fgets(line, sizeof(line), file) != NULL) apply_setting(settings, line); 
+        fclose(file); 
+    }
+    for (int i = 1; i < argc; ++i) apply_setting(settings, argv[i]); 
+}
+
 struct App {
     // basic sdl2
     SDL_Window *window; 
     SDL_Renderer *renderer; 
+    struct Settings settings; 
+    SDL_Texture *frame; // the internal frame, NULL when drawing straight to the window 
+    SDL_Rect frame_rect; // the part of the frame drawn to this frame 
+    SDL_Rect display; // the letterboxed part of the window 
+    struct RenderQueue queue; // everything drawn in a frame, submitted at the end of update_and_render 
     int running; 
+    int visible; // 0 while the window is minimized or hidden, nothing is rendered then 
     float delta_time;
+    struct Governor governor; // scales the game's optional work to the measured frame time 
+    struct Latency latency; // only filled in with the latency setting on 
+    struct InputTrace drawn; // the newest input in the snapshot the game was last drawn from 
 
     // manages state and state transitions
     enum AppState state; 
@@ -25,9 +83,16 @@ struct App {
 
     int came_from_editor; // this will just keep track of if we came from the editor so I know to go back to that 
 
+    // attempt logging, flushed by a background thread 
+    struct Telemetry telemetry; 
+
+    // images shared between all of the states 
+    struct Assets assets; 
+
     // tiles for the menu and the font
     SDL_Texture *tiles; 
     TTF_Font *font; 
+    struct Glyphs glyphs; // the font again, as an atlas for text that changes every frame 
     unsigned mouse_row, mouse_col; // keeps track of mouse for menu drawing
 
     // progress data 
@@ -39,6 +104,7 @@ struct App {
     unsigned last_id; // stores the id of the last level 
 
     // state data
+    struct PreviewCache previews; // level previews for both of the level selects 
     struct OfficialSelect official; 
     struct CustomSelect custom; 
     struct Game game; 
@@ -49,10 +115,10 @@ struct App {
 void enter_app_state(struct App *app) {
     // prepare a new state for entry 
     if (app->next_state == InOfficial) {
-        enter_official_select(&app->official, app->renderer, app->font, app->num_completed); 
+        enter_official_select(&app->official, app->num_completed); 
     }
     else if (app->next_state == InCustom) {
-        enter_custom_select(&app->custom, app->renderer, app->font, app->num_custom); 
+        enter_custom_select(&app->custom, app->num_custom); 
     }
     else if (app->next_state == InGame) {
         
@@ -71,12 +137,14 @@ void enter_app_state(struct App *app) {
             sprintf(path, "levels/%s/%d.lvl", app->last_type == OfficialLevel ? "official" : "custom", app->last_id);
             enter_game(&app->game, path, app->font, app->renderer); 
         }
-       
+
+        // the game runs on its own thread for as long as it is the current state 
+        start_game_thread(&app->game); 
     }
     else if (app->next_state == InEditor) {
         char path[32];
         sprintf(path, "levels/%s/%d.lvl", app->last_type == OfficialLevel ? "official" : "custom", app->last_id);
-        enter_editor_state(&app->editor, app->renderer, app->font, path); 
+        enter_editor_state(&app->editor, path); 
     }
     else if (app->next_state == InOverlay) {
         enum OverlayType type = app->game.player.state == Winning? WinPage: app->game.player.state == Exploding? LosePage: PausePage; 
@@ -93,31 +161,31 @@ void enter_app_state(struct App *app) {
 
 void exit_app_state(struct App *app) {
     // cleanup the old state when entering a new state
-    if (app->state == InOfficial) {
-        cleanup_previews(app->official.previews); 
-    }
-    else if (app->state == InCustom) {
-        cleanup_previews(app->custom.previews); 
-    }
-    else if (app->state == InGame) {
+    // the menus have nothing to clean up, their previews stay in the cache 
+    if (app->state == InGame) {
+        stop_game_thread(&app->game); 
+
         // do not delete if entering an overlay state
         if (app->next_state != InOverlay) {
             char path[32];
             sprintf(path, "levels/%s/%d.lvl", app->last_type == OfficialLevel ? "official" : "custom", app->last_id);
-            exit_game(&app->game, path, app->last_type, app->last_id, &app->num_completed); 
+            exit_game(&app->game, path, app->last_type, app->last_id, &app->num_completed, &app->telemetry); 
+            invalidate_preview(&app->previews, app->last_type, app->last_id); // the record may have been written 
         }
     }
     else if (app->state == InEditor) {
         char path[32];
         sprintf(path, "levels/%s/%d.lvl", app->last_type == OfficialLevel ? "official" : "custom", app->last_id);
         exit_editor_state(&app->editor, path); 
+        invalidate_preview(&app->previews, app->last_type, app->last_id); 
     }
     else if (app->state == InOverlay) {
         // exit the game bellow the overlay when the overlay is exititng if it is win or lose or pause with a restart flag 
         if (app->overlay.type == WinPage || app->overlay.type == LosePage || (app->overlay.type == PausePage && app->overlay.pause_restart_game)) {
             char path[32];
             sprintf(path, "levels/%s/%d.lvl", app->last_type == OfficialLevel ? "official" : "custom", app->last_id);
-            exit_game(&app->game, path, app->last_type, app->last_id, &app->num_completed);    
+            exit_game(&app->game, path, app->last_type, app->last_id, &app->num_completed, &app->telemetry);    
+            invalidate_preview(&app->previews, app->last_type, app->last_id); 
         }
         
 
@@ -127,7 +195,7 @@ void exit_app_state(struct App *app) {
 }
      
 
-void init_app(struct App *app) {
+void init_app(struct App *app, int argc, char *argv[]) {
     // initialize permanent objects (run at program startup); 
     // sdl2 init
     SDL_Init(SDL_INIT_VIDEO); 
@@ -138,8 +206,21 @@ void init_app(struct App *app) {
     app->window = SDL_CreateWindow("Rolleron", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1280, 720, SDL_WINDOW_RESIZABLE);
     SDL_MaximizeWindow(app->window);
 
-    app->renderer = SDL_CreateRenderer(app->window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); 
+    // the driver and vsync come from the settings (./bin/benchmark compares the drivers on a machine) 
+    load_settings(&app->settings, argc, argv); 
+    app->renderer = create_renderer(app->window, app->settings.renderer[0] ? find_render_driver(app->settings.renderer): -1, app->settings.vsync); 
+    SDL_RenderGetViewport(app->renderer, &app->display); 
+
+    // a fixed internal frame keeps the fill cost the same on every display, it is stretched over the letterboxed window at the end of each frame 
+    app->frame = NULL; 
+    if (app->settings.render_w > 0) {
+        app->frame = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, app->settings.render_w, app->settings.render_h); 
+        SDL_SetTextureScaleMode(app->frame, app->settings.linear_upscale? SDL_ScaleModeLinear: SDL_ScaleModeNearest); 
+    }
     app->running = 1; 
+    app->visible = 1; 
+    init_governor(&app->governor, app->settings.target_fps); 
+    init_latency(&app->latency); 
 
     // app icon
     SDL_Surface* icon = IMG_Load("assets/app_icon.png"); // load PNG
@@ -150,19 +231,25 @@ void init_app(struct App *app) {
     app->state = InOfficial; 
     app->next_state = InOfficial;
 
-    app->tiles = IMG_LoadTexture(app->renderer, "assets/low_res_tiles.png"); 
+    init_render_queue(&app->queue, app->renderer); 
+    init_assets(&app->assets, app->renderer); 
+    app->tiles = load_asset(&app->assets, app->renderer, "assets/low_res_tiles.png"); 
     app->font = TTF_OpenFont("assets/conthrax.otf", 64);
+    init_glyphs(&app->glyphs, app->font, app->renderer); 
 
     FILE *file = fopen("levels/progress.dat", "rb"); 
     fread(&app->num_completed, sizeof(unsigned), 1, file); 
     fread(&app->num_custom, sizeof(unsigned), 1, file); 
     fclose(file); 
 
+    init_telemetry(&app->telemetry); 
+
     // intialize each of the app states and enter the current state
-    init_official_select(&app->official, app->renderer, app->font, app->num_completed);
-    init_custom_select(&app->custom, app->renderer, app->font, app->num_custom); 
-    init_game(&app->game, app->renderer); 
-    init_editor(&app->editor, app->renderer, app->font);
+    init_preview_cache(&app->previews, app->renderer); 
+    init_official_select(&app->official, app->renderer, app->font, &app->assets, &app->previews, app->num_completed);
+    init_custom_select(&app->custom, app->renderer, app->font, &app->assets, &app->previews, app->num_custom); 
+    init_game(&app->game, app->renderer, &app->assets); 
+    init_editor(&app->editor, app->renderer, app->font, &app->assets);
     init_overlay(&app->overlay, app->renderer, app->font); 
     enter_app_state(app); 
 
@@ -174,13 +261,21 @@ void cleanup_app(struct App *app) {
 
     // cleanup all states
     cleanup_overlay(&app->overlay); 
-    cleanup_editor(&app->editor); 
-    cleanup_game(&app->game); 
+    cleanup_editor(&app->editor, &app->assets); 
+    cleanup_game(&app->game, &app->assets); 
     cleanup_custom_select(&app->custom); 
     cleanup_official_select(&app->official); 
+    cleanup_preview_cache(&app->previews); 
 
+    cleanup_telemetry(&app->telemetry); 
+    if (app->settings.latency) save_latency(&app->latency, LATENCY_PATH); 
+
+    cleanup_glyphs(&app->glyphs); 
     TTF_CloseFont(app->font);
-    SDL_DestroyTexture(app->tiles); 
+    release_asset(&app->assets, app->tiles); 
+    cleanup_assets(&app->assets); 
+    cleanup_render_queue(&app->queue); 
+    SDL_DestroyTexture(app->frame); 
     SDL_DestroyWindow(app->window); 
     SDL_DestroyRenderer(app->renderer); 
     TTF_Quit(); 
@@ -199,7 +294,16 @@ void handle_events(struct App *app) {
             int window_w = event.window.data1, window_h = event.window.data2; 
             int display_w = (float)window_w/window_h > 16/9.0 ? window_h * 16/9.0: window_w; 
             int display_h = (float)window_w/window_h > 16/9.0 ? window_h: window_w / (16/9.0); 
-            SDL_RenderSetViewport(app->renderer, &(SDL_Rect){(window_w - display_w)/2, (window_h - display_h)/2, display_w, display_h});
+            app->display = (SDL_Rect){(window_w - display_w)/2, (window_h - display_h)/2, display_w, display_h}; 
+            SDL_RenderSetViewport(app->renderer, &app->display);
+        }
+
+        // stop rendering while the window cannot be seen 
+        else if (event.type == SDL_WINDOWEVENT && (event.window.event == SDL_WINDOWEVENT_MINIMIZED || event.window.event == SDL_WINDOWEVENT_HIDDEN)) {
+            app->visible = 0; 
+        }
+        else if (event.type == SDL_WINDOWEVENT && (event.window.event == SDL_WINDOWEVENT_RESTORED || event.window.event == SDL_WINDOWEVENT_SHOWN || event.window.event == SDL_WINDOWEVENT_MAXIMIZED || event.window.event == SDL_WINDOWEVENT_EXPOSED)) {
+            app->visible = 1; 
         }
 
         // mouse position tracking for menus 
@@ -209,16 +313,16 @@ void handle_events(struct App *app) {
 
         // state specific event dispatch 
         if (app->state == InOfficial) {
-            handle_official_event(&app->official, &event, app->renderer, app->font, app->num_completed, &app->next_state, &app->last_type, &app->last_id); 
+            handle_official_event(&app->official, &event, app->renderer, app->num_completed, &app->next_state, &app->last_type, &app->last_id); 
         }
         else if (app->state == InCustom) {
-            handle_custom_event(&app->custom, &event, app->renderer, app->font, &app->num_custom, &app->next_state, &app->last_type, &app->last_id); 
+            handle_custom_event(&app->custom, &event, app->renderer, &app->num_custom, &app->next_state, &app->last_type, &app->last_id); 
         }
         else if (app->state == InGame) {
             handle_game_event(&app->game, &event, &app->next_state); 
         }
         else if (app->state == InEditor) {
-            handle_editor_event(&app->editor, &event, app->renderer, app->font, &app->next_state); 
+            handle_editor_event(&app->editor, &event, app->renderer, &app->glyphs, &app->next_state); 
         }
         else if (app->state == InOverlay) {
             handle_overlay_event(&app->overlay, &event, app->renderer, app->last_type, &app->next_state, &app->last_id, app->came_from_editor); 
@@ -226,26 +330,88 @@ void handle_events(struct App *app) {
     }
 }
 
+// whether the current state changes on its own, the menus and the overlay only change on input (or previews arriving) so the loop can sleep until some arrives 
+int app_needs_frames(struct App *app) {
+    if (app->state == InGame) return 1; 
+    else if (app->state == InEditor) return editor_needs_frames(&app->editor); 
+    else if (app->state == InOfficial || app->state == InCustom) return app->previews.num_pending > 0; 
+    return 0; 
+}
+
 void update_and_render(struct App *app) {
     // update if needed and render the current state
     if (app->state == InOfficial) {
-        render_official_select(&app->official, app->renderer, app->tiles, app->mouse_row, app->mouse_col, app->num_completed); 
+        render_official_select(&app->official, &app->queue, app->tiles, &app->glyphs, app->mouse_row, app->mouse_col, app->num_completed); 
     }
     else if (app->state == InCustom) {
-        render_custom_select(&app->custom, app->renderer, app->tiles, app->mouse_row, app->mouse_col, app->num_custom); 
+        render_custom_select(&app->custom, &app->queue, app->tiles, &app->glyphs, app->mouse_row, app->mouse_col, app->num_custom); 
     }
     else if (app->state == InGame) {
-        update_game(&app->game, app->delta_time, app->font, app->renderer, &app->next_state); 
-        render_game(&app->game, app->renderer); 
+        // the simulation steps on its own thread, this only draws its newest snapshot 
+        update_game_thread(&app->game, &app->next_state); 
+        render_game(&app->game, &app->queue, &app->glyphs); 
+        if (app->settings.latency) {
+            struct GameSnapshot *drawn = get_front_snapshot(&app->game.snapshots); 
+            app->drawn = (struct InputTrace){drawn->input_counter, drawn->step_counter, SDL_GetPerformanceCounter()}; 
+            render_latency(&app->latency, &app->queue, &app->glyphs); 
+        }
     }
     else if (app->state == InEditor) {
         update_editor(&app->editor); 
-        render_editor(&app->editor, app->renderer, app->tiles, app->mouse_row, app->mouse_col); 
+        render_editor(&app->editor, &app->queue, app->tiles, &app->glyphs, app->mouse_row, app->mouse_col); 
     }
     else if (app->state == InOverlay) {
-        render_game(&app->game, app->renderer); 
-        render_overlay(&app->overlay, app->renderer, app->tiles, app->mouse_row, app->mouse_col); 
+        render_overlay(&app->overlay, &app->queue, app->tiles, &app->game, &app->glyphs, app->mouse_row, app->mouse_col); 
     }
+
+    // draw it all now, the state transition right after can destroy textures that are queued 
+    submit_render_queue(&app->queue); 
+}
+
+// without a fixed render size the game still needs a frame to draw into at a lower resolution, so one the size of the window is made while it does 
+void update_frame(struct App *app) {
+    if (app->settings.render_w > 0) return; 
+
+    int needed = app->state == InGame && get_quality(&app->governor)->render_scale < 1; 
+    int w = 0, h = 0; 
+    if (app->frame != NULL) SDL_QueryTexture(app->frame, NULL, NULL, &w, &h); 
+    if (app->frame != NULL && (!needed || w != app->display.w || h != app->display.h)) {
+        SDL_DestroyTexture(app->frame); 
+        app->frame = NULL; 
+    }
+    if (needed && app->frame == NULL) {
+        app->frame = SDL_CreateTexture(app->renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, app->display.w, app->display.h); 
+        SDL_SetTextureScaleMode(app->frame, SDL_ScaleModeLinear); 
+    }
+}
+
+// points the renderer at the internal frame if there is one, its viewport is then the part of the frame in use 
+void begin_frame(struct App *app) {
+    if (app->frame != NULL) {
+        // the game draws to less of the frame when the governor turns the resolution down 
+        int w, h; 
+        SDL_QueryTexture(app->frame, NULL, NULL, &w, &h); 
+        float scale = app->state == InGame? get_quality(&app->governor)->render_scale: 1; 
+        app->frame_rect = (SDL_Rect){0, 0, w * scale, h * scale}; 
+        SDL_SetRenderTarget(app->renderer, app->frame); 
+        SDL_RenderSetViewport(app->renderer, &app->frame_rect); 
+    }
+    begin_render_queue(&app->queue); 
+}
+
+void end_frame(struct App *app) {
+    if (app->frame != NULL) {
+        // back to the window with the letterboxed viewport, which the mouse math between frames relies on, then stretch the frame over it 
+        Uint8 r, g, b, a; // parts of the states rely on the draw color from the last frame 
+        SDL_GetRenderDrawColor(app->renderer, &r, &g, &b, &a); 
+        SDL_SetRenderTarget(app->renderer, NULL); 
+        SDL_SetRenderDrawColor(app->renderer, 0, 0, 0, 255); 
+        SDL_RenderClear(app->renderer); 
+        SDL_RenderSetViewport(app->renderer, &app->display); 
+        SDL_RenderCopy(app->renderer, app->frame, &app->frame_rect, NULL); 
+        SDL_SetRenderDrawColor(app->renderer, r, g, b, a); 
+    }
+    SDL_RenderPresent(app->renderer); 
 }
 
 void run_app(struct App *app) {
@@ -256,11 +422,28 @@ void run_app(struct App *app) {
     unsigned long frequency = SDL_GetPerformanceFrequency();
     
     while (app->running) {
+        // block until there is input when nothing would change, the event is left in the queue for handle_events 
+        if (!app->visible || !app_needs_frames(app)) {
+            SDL_WaitEventTimeout(NULL, IDLE_WAIT_MS); 
+            last_time = SDL_GetPerformanceCounter(); // the wait is not time the next state should simulate 
+        }
+
         unsigned long current_time = SDL_GetPerformanceCounter(); 
         app->delta_time = (current_time - last_time)/(float)frequency; 
         
         handle_events(app); 
-        update_and_render(app); 
+        if (app->visible) {
+            update_frame(app); 
+            begin_frame(app); 
+
+            // only the game's work is scaled, so only its frames are measured (present is left out, since with vsync it is mostly waiting) 
+            Uint64 work_start = SDL_GetPerformanceCounter(); 
+            update_and_render(app); 
+            if (app->state == InGame && app->next_state == InGame) {
+                update_governor(&app->governor, (SDL_GetPerformanceCounter() - work_start)/(float)frequency, app->delta_time); 
+                SDL_AtomicSet(&app->game.quality_level, app->governor.level); 
+            }
+        }
 
         // manages the state transition 
         if (app->state != app->next_state) {
@@ -270,16 +453,20 @@ void run_app(struct App *app) {
 
         }
 
-        SDL_RenderPresent(app->renderer); 
+        if (app->visible) {
+            end_frame(app); 
+            // the present has returned, so the input the game drew in this frame has made it all the way 
+            if (app->settings.latency && app->state == InGame) record_latency(&app->latency, app->drawn.input, app->drawn.step, app->drawn.render, SDL_GetPerformanceCounter()); 
+        }
 
         last_time = current_time;   
     }
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     // simply create the app, initialize it, run it, and then clean it up
     struct App app; 
-    init_app(&app);    
+    init_app(&app, argc, argv);    
     run_app(&app); 
     cleanup_app(&app); 
 
@@ -16,86 +16,103 @@ struct OfficialSelect {
     struct Button left; 
     struct Button right; 
 
-    // previews themselves 
-    struct LevelPreview previews[6]; 
+    // previews themselves, out of the cache shared with the custom select (owned by the app) 
+    struct PreviewCache *cache; 
+    struct LevelPreview *previews[6]; 
 
     unsigned page; 
+
+    // everything above drawn once per page 
+    struct MenuLayer layer; 
 }; 
 
-void init_official_select(struct OfficialSelect *select, SDL_Renderer *renderer, TTF_Font *font, unsigned num_completed) {
+void init_official_select(struct OfficialSelect *select, SDL_Renderer *renderer, TTF_Font *font, struct Assets *assets, struct PreviewCache *cache, unsigned num_completed) {
     // just intialize the permanent buttons that are not reset when the state is reentered 
     init_button(&select->official, 0, 2, 5, "Official", font, renderer); 
     select->official.enabled = 0; 
     init_button(&select->custom, 0, 9, 5, "Custom", font, renderer); 
-    init_special_text_button(&select->left, 0, 0, 1, IMG_LoadTexture(renderer, "assets/left.png")); 
-    init_special_text_button(&select->right, 0, UI_W - 1, 1, IMG_LoadTexture(renderer, "assets/right.png")); 
+    init_icon_button(&select->left, 0, 0, 1, assets, LeftIcon); 
+    init_icon_button(&select->right, 0, UI_W - 1, 1, assets, RightIcon); 
     select->page = num_completed / 6; 
+    select->cache = cache; 
+    init_menu_layer(&select->layer, 1); 
 }
 
 void cleanup_official_select(struct OfficialSelect *select) {
-    SDL_DestroyTexture(select->left.text); 
-    SDL_DestroyTexture(select->right.text); 
+    cleanup_menu_layer(&select->layer); 
     SDL_DestroyTexture(select->custom.text); 
     SDL_DestroyTexture(select->official.text); 
 }
 
-void enter_official_select(struct OfficialSelect *select, SDL_Renderer *renderer, TTF_Font *font, unsigned num_completed) {
-    // create the level previews 
+void enter_official_select(struct OfficialSelect *select, unsigned num_completed) {
+    // get the level previews 
     for (int i = 0; i < 6; ++i) {
         unsigned level_num = select->page * 6 + i; 
-        if (level_num < NUM_OFFICIALS) { // if the level exists then we can make it 
-            char path[32]; 
-            sprintf(path, "levels/official/%d.lvl", level_num); // level id is just the level number in official levels, in custom levels it is not since they can be deleted
+        // level id is just the level number in official levels, in custom levels it is not since they can be deleted 
+        if (level_num < NUM_OFFICIALS) select->previews[i] = get_preview(select->cache, OfficialLevel, level_num); 
+        else select->previews[i] = NULL; // level does not exist, and it will not be rendered 
+    }
 
-            init_preview(&select->previews[i], font, renderer, path); 
-        }
-        else { // level does not exist, then set everything to null, and it will not be rendered
-            select->previews[i].name = NULL; 
-            select->previews[i].record = NULL; 
-            select->previews[i].map = NULL; 
-        }
+    // then start on the pages to either side, after this page's since the worker goes in order 
+    for (int i = -6; i < 12; ++i) {
+        int level_num = (int)select->page * 6 + i; 
+        if ((i < 0 || i >= 6) && level_num >= 0 && level_num < NUM_OFFICIALS) prefetch_preview(select->cache, OfficialLevel, level_num); 
     }
 
     // update if the left and right buttons are enabled
     select->left.enabled = select->page > 0; 
     select->right.enabled = select->page < NUM_OFFICIALS/6; 
-}
 
-void render_official_select(struct OfficialSelect *select, SDL_Renderer *renderer, SDL_Texture *tiles, int mouse_row, int mouse_col, unsigned num_completed) {
-    // render the buttons and the level previews 
-    render_background(renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->official, renderer, tiles, mouse_row, mouse_col);
-    render_button(&select->custom, renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->left, renderer, tiles, mouse_row, mouse_col); 
-    render_button(&select->right, renderer, tiles, mouse_row, mouse_col); 
+    // layout for hovering and clicks, the layer itself is redrawn on the next render 
+    clear_menu_layer(&select->layer); 
+    add_menu_button(&select->layer, &select->official); 
+    add_menu_button(&select->layer, &select->custom); 
+    add_menu_button(&select->layer, &select->left); 
+    add_menu_button(&select->layer, &select->right); 
     for (int i = 0; i < 6; ++i) {
-        // like init, render assumes it exists
-        if (select->page * 6 + i < NUM_OFFICIALS) { // only render existing levels, enable it if it is less than the number of completed levels, otherwise, it will not be enabled and the record of infinity will not show anyway since it was initialized to null 
-            render_preview(&select->previews[i], i, renderer, tiles, mouse_row, mouse_col, select->page * 6 + i <= num_completed);
+        if (select->page * 6 + i < NUM_OFFICIALS) add_menu_preview(&select->layer, i, select->page * 6 + i <= num_completed); 
+    }
+}
+
+void render_official_select(struct OfficialSelect *select, struct RenderQueue *queue, SDL_Texture *tiles, struct Glyphs *glyphs, int mouse_row, int mouse_col, unsigned num_completed) {
+    // render the buttons and the level previews into the layer if they changed (with no mouse, the layer draws the hover outline on top) 
+    if (update_preview_cache(select->cache)) select->layer.dirty = 1; // previews that finished loading 
+    if (begin_menu_layer(&select->layer, queue)) {
+        render_background(queue, tiles); 
+        render_button(&select->official, queue, tiles, -1, -1);
+        render_button(&select->custom, queue, tiles, -1, -1); 
+        render_button(&select->left, queue, tiles, -1, -1); 
+        render_button(&select->right, queue, tiles, -1, -1); 
+        for (int i = 0; i < 6; ++i) {
+            // like init, render assumes it exists
+            if (select->page * 6 + i < NUM_OFFICIALS) { // only render existing levels, enable it if it is less than the number of completed levels, otherwise, it will not be enabled and the record of infinity will not show anyway since it was initialized to null 
+                render_preview(select->previews[i], select->cache, i, queue, tiles, glyphs, -1, -1, select->page * 6 + i <= num_completed);
+            }
         }
+        end_menu_layer(&select->layer, queue); 
     }
+    render_menu_layer(&select->layer, queue, mouse_row, mouse_col); 
 }
 
-void handle_official_event(struct OfficialSelect *select, SDL_Event *event, SDL_Renderer *renderer, TTF_Font *font, int num_completed, enum AppState *next_state, enum LevelType *last_type, unsigned *last_id) {
+void handle_official_event(struct OfficialSelect *select, SDL_Event *event, SDL_Renderer *renderer, int num_completed, enum AppState *next_state, enum LevelType *last_type, unsigned *last_id) {
     if (event->type == SDL_MOUSEBUTTONDOWN) {
         unsigned mrow, mcol; 
         get_mouse_coords(event->button.x, event->button.y, renderer, &mrow, &mcol); 
+        struct Button *button = get_menu_button(&select->layer, mrow, mcol); 
 
         // left and right 
-        if (select->left.enabled && is_mouse_over_button(&select->left, mrow, mcol)) {
-            cleanup_previews(select->previews); 
+        if (button == &select->left && select->left.enabled) {
             --select->page; 
-            enter_official_select(select, renderer, font, num_completed); 
+            enter_official_select(select, num_completed); 
         }
-        else if (select->right.enabled && is_mouse_over_button(&select->right, mrow, mcol)) {
-            cleanup_previews(select->previews); 
+        else if (button == &select->right && select->right.enabled) {
             ++select->page; 
-            enter_official_select(select, renderer, font, num_completed); 
+            enter_official_select(select, num_completed); 
         }
         
 
         // go to the custom tab 
-        else if (is_mouse_over_button(&select->custom, mrow, mcol)) {
+        else if (button == &select->custom) {
             *next_state = InCustom; 
         }
         
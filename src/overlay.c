@@ -5,6 +5,9 @@
 #include <SDL_mixer.h> 
 
 #include "lib.c"
+#include "game.c" // the frozen game frame under the overlay 
+
+#define OVERLAY_DIM 96 // alpha of the black over the frozen game 
 
 struct GameOverlay {
     enum OverlayType {WinPage, LosePage, PausePage} type; 
@@ -33,6 +36,8 @@ struct GameOverlay {
     struct Button next; 
     struct Button resume; 
 
+    // the frozen game, dimmed, with everything above on top, drawn once per entry 
+    struct MenuLayer layer; 
 }; 
 
 void init_overlay(struct GameOverlay *overlay, SDL_Renderer *renderer, TTF_Font *font) {
@@ -48,9 +53,11 @@ void init_overlay(struct GameOverlay *overlay, SDL_Renderer *renderer, TTF_Font
     init_button(&overlay->restart, 12, 9, 6, "Restart", font, renderer); 
     init_button(&overlay->next, 12, 17, 6, "Next", font, renderer); 
     init_button(&overlay->resume, 12, 17, 6, "Resume", font, renderer); 
+    init_menu_layer(&overlay->layer, 0); 
 }
 
 void cleanup_overlay(struct GameOverlay *overlay) { 
+    cleanup_menu_layer(&overlay->layer); 
     SDL_DestroyTexture(overlay->resume.text); 
     SDL_DestroyTexture(overlay->next.text); 
     SDL_DestroyTexture(overlay->restart.text); 
@@ -85,6 +92,13 @@ void enter_overlay_state(struct GameOverlay *overlay, enum OverlayType type, flo
     }
     else overlay->next.enabled = 1; 
 
+    // layout for hovering and clicks, the layer itself is redrawn on the next render 
+    clear_menu_layer(&overlay->layer); 
+    add_menu_button(&overlay->layer, &overlay->exit); 
+    add_menu_button(&overlay->layer, &overlay->restart); 
+    if (overlay->type == WinPage) add_menu_button(&overlay->layer, &overlay->next); 
+    else if (overlay->type == PausePage) add_menu_button(&overlay->layer, &overlay->resume); 
+
 
     // we have to do this here instead of in the game because the game will just turn the sound back on after turning it off since it gets one more update sound call after handle events triggers the pause page
     if (overlay->type == PausePage) {
@@ -99,43 +113,43 @@ void exit_overlay_state(struct GameOverlay *overlay) {
     
 }
 
-void render_overlay(struct GameOverlay *overlay, SDL_Renderer *renderer, SDL_Texture *tiles, int mrow, int mcol) {
-    SDL_Texture *header = (overlay->type == WinPage)? overlay->completed: (overlay->type == LosePage)? overlay->destroyed: overlay->paused; 
-    render_menu_text(renderer, header, 1, UI_W/2.0, 1.5, Middle);
-
-    render_menu_text(renderer, overlay->name, 3, UI_W/2.0, 1.0, Middle);
-
-    render_menu_text(renderer, overlay->time_label, 5, UI_W * 0.25, 0.5, Middle); 
-    render_menu_text(renderer, overlay->time, 6, UI_W * 0.25, 1.5, Middle); 
-
-    if (overlay->record != NULL) {
-        render_menu_text(renderer, overlay->record_label, 5, UI_W * 0.75, 0.5, Middle); 
-        render_menu_text(renderer, overlay->record, 6, UI_W * 0.75, 1.5, Middle); 
-    }
-
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); // give it a constant white outline to make it pop out of the bg 
-    // when the blue outline happens, the render color is set to blue for the second, so it looks fine 
+void render_overlay(struct GameOverlay *overlay, struct RenderQueue *queue, SDL_Texture *tiles, struct Game *game, struct Glyphs *glyphs, int mrow, int mcol) {
+    // everything but the hover outline goes into the layer once per entry, the game does not change under the overlay so it is captured there too 
+    if (begin_menu_layer(&overlay->layer, queue)) {
+        SDL_Renderer *renderer = queue->renderer; 
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+        SDL_RenderClear(renderer); 
+        render_game(game, queue, glyphs); 
+        submit_render_queue(queue); // all of the game goes under the dim 
 
-    render_button(&overlay->exit, renderer, tiles, mrow, mcol);
-    render_menu_outline(renderer, overlay->exit.row, overlay->exit.col, overlay->exit.width, 1); 
+        // dim the game once here so the text stands out, instead of every frame 
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND); 
+        SDL_SetRenderDrawColor(renderer, 0, 0, 0, OVERLAY_DIM); 
+        SDL_RenderFillRect(renderer, NULL); 
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE); 
 
-    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); 
-    render_button(&overlay->restart, renderer, tiles, mrow, mcol);  
-    render_menu_outline(renderer, overlay->restart.row, overlay->restart.col, overlay->restart.width, 1); 
+        SDL_Texture *header = (overlay->type == WinPage)? overlay->completed: (overlay->type == LosePage)? overlay->destroyed: overlay->paused; 
+        render_menu_text(queue, header, 1, UI_W/2.0, 1.5, Middle);
 
+        render_menu_text(queue, overlay->name, 3, UI_W/2.0, 1.0, Middle);
 
-    if (overlay->type == WinPage) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); 
-        render_button(&overlay->next, renderer, tiles, mrow, mcol); 
-        render_menu_outline(renderer, overlay->next.row, overlay->next.col, overlay->next.width, 1); 
+        render_menu_text(queue, overlay->time_label, 5, UI_W * 0.25, 0.5, Middle); 
+        render_menu_text(queue, overlay->time, 6, UI_W * 0.25, 1.5, Middle); 
 
-    }
-    else if (overlay->type == PausePage) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255); 
-        render_button(&overlay->resume, renderer, tiles, mrow, mcol); 
-        render_menu_outline(renderer, overlay->resume.row, overlay->resume.col, overlay->resume.width, 1); 
+        if (overlay->record != NULL) {
+            render_menu_text(queue, overlay->record_label, 5, UI_W * 0.75, 0.5, Middle); 
+            render_menu_text(queue, overlay->record, 6, UI_W * 0.75, 1.5, Middle); 
+        }
 
+        // give the buttons a constant white outline to make them pop out of the bg, the hover outline is drawn over it by the layer 
+        struct Button *buttons[3] = {&overlay->exit, &overlay->restart, overlay->type == WinPage? &overlay->next: overlay->type == PausePage? &overlay->resume: NULL}; 
+        for (int i = 0; i < 3 && buttons[i] != NULL; ++i) {
+            render_button(buttons[i], queue, tiles, -1, -1); 
+            render_menu_outline(queue, buttons[i]->row, buttons[i]->col, buttons[i]->width, 1, BATCH_WHITE); 
+        }
+        end_menu_layer(&overlay->layer, queue); 
     }
+    render_menu_layer(&overlay->layer, queue, mrow, mcol); 
 }
 
 void handle_overlay_event(struct GameOverlay *overlay, SDL_Event *event, SDL_Renderer *renderer, enum LevelType last_type, enum AppState *next_state, unsigned *last_id, int came_from_editor) {
@@ -143,8 +157,9 @@ void handle_overlay_event(struct GameOverlay *overlay, SDL_Event *event, SDL_Ren
     if (event->type == SDL_MOUSEBUTTONDOWN) {
         unsigned mrow, mcol; 
         get_mouse_coords(event->button.x, event->button.y, renderer, &mrow, &mcol); 
+        struct Button *button = get_menu_button(&overlay->layer, mrow, mcol); 
 
-        if (is_mouse_over_button(&overlay->exit, mrow, mcol)) {
+        if (button == &overlay->exit) {
             if (last_type == OfficialLevel) *next_state = InOfficial; 
             else if (last_type == CustomLevel && !came_from_editor) *next_state = InCustom; 
             else if (last_type == CustomLevel && came_from_editor) *next_state = InEditor; 
@@ -152,19 +167,19 @@ void handle_overlay_event(struct GameOverlay *overlay, SDL_Event *event, SDL_Ren
             if (overlay->type == PausePage) overlay->pause_restart_game = 1; // exit the game when leaving overlay into the editor state 
         }
 
-        else if (is_mouse_over_button(&overlay->restart, mrow, mcol)) {
+        else if (button == &overlay->restart) {
             *next_state = InGame; 
 
             // exit and restart the game when exitinig with the restart button from pause page
             if (overlay->type == PausePage) overlay->pause_restart_game = 1; 
         }
 
-        else if (overlay->type == WinPage && overlay->next.enabled && is_mouse_over_button(&overlay->next, mrow, mcol)) {
+        else if (button == &overlay->next && overlay->next.enabled) {
             ++*last_id; // increment the id for the next game 
             *next_state = InGame; 
         }
 
-        else if (overlay->type == PausePage && is_mouse_over_button(&overlay->resume, mrow, mcol)) {
+        else if (button == &overlay->resume) {
             *next_state = InGame; 
             
             // do not restart the game if exiting from unpause 
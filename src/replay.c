@@ -0,0 +1,111 @@
+/*
+Replay recording. The physics only depends on the frame times and the thruster controls, so a replay is just a copy of the level plus those per frame.
+The buffer is allocated once at startup, and recording a frame is only a store. Replays are played back by the offline renderer (replay_render.c).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL.h>
+
+#include "lib.c"
+
+#ifndef REPLAY_C
+#define REPLAY_C
+
+#define REPLAY_DIR "levels/replays"
+#define MAX_REPLAY_FRAMES (1 << 17) // about 18 minutes at the game's fixed 120 steps a second
+
+struct ReplayFrame {
+    float delta_time; 
+    unsigned controls; // bit 0 is the left thruster, bit 1 the right
+}; 
+
+struct Replay {
+    // level data at the time of the attempt, in the same order as the level files, so edits to the level later do not break the replay
+    unsigned level_type; // enum LevelType
+    unsigned level_id; 
+    char name[32]; 
+    float spawn_x, spawn_y; 
+    float spawn_rot; 
+    float record; 
+    unsigned char map[MAP_H][MAP_W]; 
+
+    struct ReplayFrame *frames; 
+    unsigned num_frames; 
+    unsigned capacity; // 0 turns recording off
+}; 
+
+void init_replay(struct Replay *replay) {
+    replay->frames = malloc(MAX_REPLAY_FRAMES * sizeof(struct ReplayFrame)); 
+    replay->num_frames = 0; 
+    replay->capacity = MAX_REPLAY_FRAMES; 
+}
+
+void cleanup_replay(struct Replay *replay) {
+    free(replay->frames); 
+}
+
+void begin_replay(struct Replay *replay, char *name, float spawn_x, float spawn_y, float spawn_rot, float record, unsigned char map[MAP_H][MAP_W]) {
+    memcpy(replay->name, name, sizeof(replay->name)); 
+    replay->spawn_x = spawn_x; 
+    replay->spawn_y = spawn_y; 
+    replay->spawn_rot = spawn_rot; 
+    replay->record = record; 
+    memcpy(replay->map, map, sizeof(replay->map)); 
+    replay->num_frames = 0; 
+}
+
+void record_replay_frame(struct Replay *replay, float delta_time, int left, int right) {
+    if (replay->num_frames < replay->capacity) {
+        replay->frames[replay->num_frames++] = (struct ReplayFrame){delta_time, (left ? 1: 0) | (right ? 2: 0)}; 
+    }
+}
+
+void save_replay(struct Replay *replay, char *path, enum LevelType level_type, unsigned level_id) {
+    // a replay that ran out of room would not reach the same end, so it is not worth keeping
+    if (replay->num_frames == 0 || replay->num_frames == replay->capacity) return; 
+
+    mkdir(REPLAY_DIR, 0755); 
+    FILE *file = fopen(path, "wb"); 
+    if (file == NULL) return; 
+
+    replay->level_type = level_type; 
+    replay->level_id = level_id; 
+    fwrite(&replay->level_type, sizeof(unsigned), 1, file); 
+    fwrite(&replay->level_id, sizeof(unsigned), 1, file); 
+    fwrite(replay->name, sizeof(replay->name), 1, file); 
+    fwrite(&replay->spawn_x, sizeof(float), 1, file); 
+    fwrite(&replay->spawn_y, sizeof(float), 1, file); 
+    fwrite(&replay->spawn_rot, sizeof(float), 1, file); 
+    fwrite(&replay->record, sizeof(float), 1, file); 
+    fwrite(replay->map, sizeof(replay->map), 1, file); 
+    fwrite(&replay->num_frames, sizeof(unsigned), 1, file); 
+    fwrite(replay->frames, sizeof(struct ReplayFrame), replay->num_frames, file); 
+    fclose(file); 
+}
+
+// loads a saved replay into a replay that was not initialized, the frames are allocated to fit and freed with cleanup_replay
+int load_replay(struct Replay *replay, char *path) {
+    FILE *file = fopen(path, "rb"); 
+    if (file == NULL) return 0; 
+
+    fread(&replay->level_type, sizeof(unsigned), 1, file); 
+    fread(&replay->level_id, sizeof(unsigned), 1, file); 
+    fread(replay->name, sizeof(replay->name), 1, file); 
+    fread(&replay->spawn_x, sizeof(float), 1, file); 
+    fread(&replay->spawn_y, sizeof(float), 1, file); 
+    fread(&replay->spawn_rot, sizeof(float), 1, file); 
+    fread(&replay->record, sizeof(float), 1, file); 
+    fread(replay->map, sizeof(replay->map), 1, file); 
+    fread(&replay->num_frames, sizeof(unsigned), 1, file); 
+
+    replay->frames = malloc(replay->num_frames * sizeof(struct ReplayFrame)); 
+    replay->num_frames = fread(replay->frames, sizeof(struct ReplayFrame), replay->num_frames, file); 
+    replay->capacity = replay->num_frames; 
+    fclose(file); 
+    return 1; 
+}
+
+#endif
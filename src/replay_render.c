@@ -0,0 +1,257 @@
+/*
+Offline replay renderer. Plays a saved replay back through the real update_game and render_game, and writes every video frame out
+as a png sequence or as one raw rgba video file (which ffmpeg can read with -f rawvideo -pix_fmt rgba).
+
+usage: ./bin/replay_render <replay> <output dir, or a file ending in .rgba> [width height fps]
+
+The video frames are split into one contiguous range per thread. Each thread has its own software renderer drawing into its own surface,
+and starts from the nearest keyframe before its range (keyframes are made by simulating the whole replay once up front, which is cheap without rendering).
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <SDL.h>
+#include <SDL_image.h>
+#include <SDL_ttf.h>
+#include <SDL_mixer.h>
+
+#include "lib.c"
+#include "game.c"
+
+#define MAX_THREADS 64
+#define KEYFRAME_INTERVAL 60 // simulation frames between keyframes
+
+// the full simulation state before a given replay frame
+struct ReplayKeyframe {
+    unsigned sim_frame; 
+    double sim_time; 
+    struct Player player; 
+    float timer; 
+    float timer_animation_timer; 
+}; 
+
+struct ReplayWorker {
+    struct Replay *replay; 
+    struct ReplayKeyframe *keyframes; 
+    unsigned num_keyframes; 
+
+    unsigned first_frame, end_frame; // video frames this worker renders
+    int fps; 
+    char *out_path; 
+    int raw; 
+
+    SDL_Surface *surface; 
+    SDL_Renderer *renderer; 
+    TTF_Font *font; 
+    struct Glyphs glyphs; 
+    struct RenderQueue queue; 
+    struct Game game; 
+
+    unsigned sim_frame; 
+    double sim_time; 
+}; 
+
+void init_replay_worker(struct ReplayWorker *worker, struct Replay *replay, int width, int height) {
+    worker->replay = replay; 
+    worker->surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32); 
+    worker->renderer = SDL_CreateSoftwareRenderer(worker->surface); 
+    worker->font = TTF_OpenFont("assets/conthrax.otf", 64); 
+    init_glyphs(&worker->glyphs, worker->font, worker->renderer); 
+    init_render_queue(&worker->queue, worker->renderer); 
+
+    // only what render_game draws, there is no audio device so the sounds stay null and the mixer calls do nothing
+    struct Game *game = &worker->game; 
+    memset(game, 0, sizeof(*game)); 
+    SDL_AtomicSet(&game->quality_level, NUM_QUALITY_LEVELS - 1); // there is no frame budget offline, so always the full effects 
+    game->low_res_tiles = IMG_LoadTexture(worker->renderer, "assets/low_res_tiles.png"); 
+    game->high_res_tiles = IMG_LoadTexture(worker->renderer, "assets/high_res_tiles.png"); 
+    game->player.texture = IMG_LoadTexture(worker->renderer, "assets/space_ship.png"); 
+    game->player.drag_creasent = IMG_LoadTexture(worker->renderer, "assets/drag_creasent.png"); 
+
+    // same as entering the game from the level file, with recording left off (capacity 0)
+    memcpy(game->map, replay->map, sizeof(game->map)); 
+    game->player.x = replay->spawn_x; 
+    game->player.y = replay->spawn_y; 
+    game->player.rot = replay->spawn_rot; 
+    game->record = replay->record; 
+    start_game(game, replay->name, worker->font, worker->renderer); 
+
+    worker->sim_frame = 0; 
+    worker->sim_time = 0; 
+}
+
+void cleanup_replay_worker(struct ReplayWorker *worker) {
+    SDL_DestroyTexture(worker->game.level_name); 
+    SDL_DestroyTexture(worker->game.map_texture); 
+    SDL_DestroyTexture(worker->game.player.drag_creasent); 
+    SDL_DestroyTexture(worker->game.player.texture); 
+    SDL_DestroyTexture(worker->game.high_res_tiles); 
+    SDL_DestroyTexture(worker->game.low_res_tiles); 
+    cleanup_render_queue(&worker->queue); 
+    cleanup_glyphs(&worker->glyphs); 
+    TTF_CloseFont(worker->font); 
+    SDL_DestroyRenderer(worker->renderer); 
+    SDL_FreeSurface(worker->surface); 
+}
+
+void step_replay_worker(struct ReplayWorker *worker) {
+    struct ReplayFrame *frame = &worker->replay->frames[worker->sim_frame]; 
+    worker->game.player.left_thruster_control = frame->controls & 1; 
+    worker->game.player.right_thruster_control = (frame->controls & 2) != 0; 
+
+    enum AppState next_state = InGame; 
+    update_game(&worker->game, frame->delta_time, &next_state); 
+
+    worker->sim_time += frame->delta_time; 
+    ++worker->sim_frame; 
+}
+
+// simulate up to the last replay frame that finished at or before the given time
+void advance_replay_worker(struct ReplayWorker *worker, double time) {
+    while (worker->sim_frame < worker->replay->num_frames && worker->sim_time + worker->replay->frames[worker->sim_frame].delta_time <= time) {
+        step_replay_worker(worker); 
+    }
+}
+
+void restore_keyframe(struct ReplayWorker *worker, struct ReplayKeyframe *keyframe) {
+    // the keyframe was made by another worker, so keep this worker's own textures
+    struct Player *player = &worker->game.player; 
+    SDL_Texture *texture = player->texture, *drag_creasent = player->drag_creasent; 
+    *player = keyframe->player; 
+    player->texture = texture; 
+    player->drag_creasent = drag_creasent; 
+
+    worker->game.timer = keyframe->timer; 
+    worker->game.timer_animation_timer = keyframe->timer_animation_timer; 
+    update_timer_text(&worker->game); 
+
+    worker->sim_frame = keyframe->sim_frame; 
+    worker->sim_time = keyframe->sim_time; 
+}
+
+int run_replay_worker(void *data) {
+    struct ReplayWorker *worker = data; 
+    if (worker->first_frame >= worker->end_frame) return 0; 
+
+    // start from the last keyframe before the first frame
+    double start_time = (double)worker->first_frame / worker->fps; 
+    unsigned k = 0; 
+    while (k + 1 < worker->num_keyframes && worker->keyframes[k + 1].sim_time <= start_time) ++k; 
+    restore_keyframe(worker, &worker->keyframes[k]); 
+
+    FILE *raw_file = NULL; 
+    size_t frame_size = (size_t)worker->surface->w * worker->surface->h * 4; 
+    if (worker->raw) {
+        raw_file = fopen(worker->out_path, "r+b"); 
+        fseek(raw_file, (long)(worker->first_frame * frame_size), SEEK_SET); 
+    }
+
+    for (unsigned frame = worker->first_frame; frame < worker->end_frame; ++frame) {
+        advance_replay_worker(worker, (double)frame / worker->fps); 
+
+        SDL_SetRenderDrawColor(worker->renderer, 0, 0, 0, 255); 
+        SDL_RenderClear(worker->renderer); 
+        begin_render_queue(&worker->queue); 
+        publish_game_snapshot(&worker->game); // simulated on this thread, so the snapshot is published right before it is drawn 
+        render_game(&worker->game, &worker->queue, &worker->glyphs); 
+        submit_render_queue(&worker->queue); 
+        SDL_RenderFlush(worker->renderer); 
+
+        if (worker->raw) {
+            for (int row = 0; row < worker->surface->h; ++row) {
+                fwrite((Uint8*)worker->surface->pixels + row * worker->surface->pitch, worker->surface->w * 4, 1, raw_file); 
+            }
+        }
+        else {
+            char path[256]; 
+            snprintf(path, sizeof(path), "%s/%06u.png", worker->out_path, frame); 
+            IMG_SavePNG(worker->surface, path); 
+        }
+    }
+
+    if (raw_file != NULL) fclose(raw_file); 
+    return 0; 
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        puts("usage: replay_render <replay> <output dir or .rgba file> [width height fps]"); 
+        return EXIT_FAILURE; 
+    }
+    int width = argc > 5 ? atoi(argv[3]): 1920; 
+    int height = argc > 5 ? atoi(argv[4]): 1080; 
+    int fps = argc > 5 ? atoi(argv[5]): 60; 
+
+    struct Replay replay; 
+    if (!load_replay(&replay, argv[1])) {
+        fprintf(stderr, "could not read %s\n", argv[1]); 
+        return EXIT_FAILURE; 
+    }
+    replay.capacity = 0; // the replay is only read from here on
+
+    IMG_Init(IMG_INIT_PNG); 
+    TTF_Init(); 
+
+    // one pass of the whole replay to make the keyframes, on a tiny surface since nothing is drawn
+    double total_time = 0; 
+    for (unsigned i = 0; i < replay.num_frames; ++i) total_time += replay.frames[i].delta_time; 
+    unsigned num_keyframes = replay.num_frames / KEYFRAME_INTERVAL + 1; 
+    struct ReplayKeyframe *keyframes = malloc(num_keyframes * sizeof(struct ReplayKeyframe)); 
+
+    struct ReplayWorker *scout = malloc(sizeof(struct ReplayWorker)); 
+    init_replay_worker(scout, &replay, 16, 9); 
+    for (unsigned k = 0; k < num_keyframes; ++k) {
+        while (scout->sim_frame < k * KEYFRAME_INTERVAL) step_replay_worker(scout); 
+        keyframes[k] = (struct ReplayKeyframe){scout->sim_frame, scout->sim_time, scout->game.player, scout->game.timer, scout->game.timer_animation_timer}; 
+    }
+    cleanup_replay_worker(scout); 
+    free(scout); 
+
+    // set up the output and one worker per cpu (all the renderers and fonts are made here so only drawing happens on the threads)
+    unsigned num_video_frames = total_time * fps + 1; 
+    int raw = strlen(argv[2]) > 5 && strcmp(argv[2] + strlen(argv[2]) - 5, ".rgba") == 0; 
+    if (raw) {
+        FILE *file = fopen(argv[2], "wb"); 
+        if (file == NULL) {
+            fprintf(stderr, "could not write %s\n", argv[2]); 
+            return EXIT_FAILURE; 
+        }
+        fclose(file); 
+    }
+    else mkdir(argv[2], 0755); 
+
+    int num_threads = SDL_GetCPUCount(); 
+    if (num_threads < 1) num_threads = 1; 
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS; 
+
+    struct ReplayWorker *workers = malloc(num_threads * sizeof(struct ReplayWorker)); 
+    SDL_Thread *threads[MAX_THREADS]; 
+    unsigned per_thread = (num_video_frames + num_threads - 1) / num_threads; 
+    for (int i = 0; i < num_threads; ++i) {
+        init_replay_worker(&workers[i], &replay, width, height); 
+        workers[i].keyframes = keyframes; 
+        workers[i].num_keyframes = num_keyframes; 
+        workers[i].first_frame = i * per_thread < num_video_frames ? i * per_thread: num_video_frames; 
+        workers[i].end_frame = workers[i].first_frame + per_thread < num_video_frames ? workers[i].first_frame + per_thread: num_video_frames; 
+        workers[i].fps = fps; 
+        workers[i].out_path = argv[2]; 
+        workers[i].raw = raw; 
+    }
+
+    Uint64 start = SDL_GetPerformanceCounter(); 
+    for (int i = 0; i < num_threads; ++i) threads[i] = SDL_CreateThread(run_replay_worker, "replay", &workers[i]); 
+    for (int i = 0; i < num_threads; ++i) SDL_WaitThread(threads[i], NULL); 
+    double seconds = (SDL_GetPerformanceCounter() - start) / (double)SDL_GetPerformanceFrequency(); 
+    printf("rendered %u frames (%.1fs of video) in %.1fs on %d threads\n", num_video_frames, total_time, seconds, num_threads); 
+
+    for (int i = 0; i < num_threads; ++i) cleanup_replay_worker(&workers[i]); 
+    free(workers); 
+    free(keyframes); 
+    cleanup_replay(&replay); 
+
+    TTF_Quit(); 
+    IMG_Quit(); 
+    return EXIT_SUCCESS; 
+}
@@ -0,0 +1,114 @@
+/*
+Attempt telemetry. Every finished attempt is pushed into a fixed size ring by the game thread, and a background thread batches the ring out to an append only binary log.
+The game thread never blocks or allocates here: if the ring is somehow full the attempt is just dropped and counted.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <SDL.h>
+
+#include "lib.c"
+
+#ifndef TELEMETRY_C
+#define TELEMETRY_C
+
+#define TELEMETRY_RING_SIZE 64
+#define TELEMETRY_PATH "levels/attempts.dat"
+#define TELEMETRY_FLUSH_MS 500
+
+// one record in the log, written out raw (every field is 4 bytes or a byte array so there is no padding)
+struct Attempt {
+    unsigned level_type; // enum LevelType
+    unsigned level_id; 
+    unsigned outcome; // the PlayerState the attempt ended in (Playing means it was abandoned)
+    float duration; 
+    int death_row, death_col; // -1 if the player did not explode
+    unsigned tiles_touched; // bitmask indexed by enum Tile
+    unsigned char visited[MAP_H][MAP_W/8]; // bitset of every cell the player has been in
+}; 
+
+struct Telemetry {
+    struct Attempt ring[TELEMETRY_RING_SIZE]; 
+    // single producer (game thread) single consumer (flush thread), so each index is only ever written by one side
+    SDL_atomic_t write_i; 
+    SDL_atomic_t read_i; 
+    SDL_atomic_t running; 
+    SDL_atomic_t dropped; // attempts lost to a full ring, counted by the game thread and reported by the flush thread
+
+    SDL_Thread *thread; 
+}; 
+
+void flush_telemetry(struct Telemetry *telemetry, FILE *file) {
+    unsigned read_i = SDL_AtomicGet(&telemetry->read_i); 
+    unsigned write_i = SDL_AtomicGet(&telemetry->write_i); 
+    if (read_i == write_i) return; 
+
+    // write the pending records as at most two contiguous runs of the ring
+    while (read_i != write_i) {
+        unsigned start = read_i % TELEMETRY_RING_SIZE; 
+        unsigned count = write_i - read_i; 
+        if (start + count > TELEMETRY_RING_SIZE) count = TELEMETRY_RING_SIZE - start; 
+        if (file != NULL) fwrite(&telemetry->ring[start], sizeof(struct Attempt), count, file); 
+        read_i += count; 
+    }
+    if (file != NULL) fflush(file); 
+
+    // only release the slots once they are on disk
+    SDL_AtomicSet(&telemetry->read_i, read_i); 
+}
+
+// the log is only whole records, so drops go to stderr instead, once each time the count goes up
+void report_telemetry_drops(struct Telemetry *telemetry, unsigned *reported) {
+    unsigned dropped = SDL_AtomicGet(&telemetry->dropped); 
+    if (dropped != *reported) {
+        fprintf(stderr, "telemetry: %u attempts dropped because the ring was full\n", dropped); 
+        *reported = dropped; 
+    }
+}
+
+int run_telemetry_thread(void *data) {
+    struct Telemetry *telemetry = data; 
+    FILE *file = fopen(TELEMETRY_PATH, "ab"); 
+    unsigned reported = 0; 
+
+    while (SDL_AtomicGet(&telemetry->running)) {
+        flush_telemetry(telemetry, file); 
+        report_telemetry_drops(telemetry, &reported); 
+        SDL_Delay(TELEMETRY_FLUSH_MS); 
+    }
+    // catch anything recorded during shutdown
+    flush_telemetry(telemetry, file); 
+    report_telemetry_drops(telemetry, &reported); 
+
+    if (file != NULL) fclose(file); 
+    return 0; 
+}
+
+void init_telemetry(struct Telemetry *telemetry) {
+    SDL_AtomicSet(&telemetry->write_i, 0); 
+    SDL_AtomicSet(&telemetry->read_i, 0); 
+    SDL_AtomicSet(&telemetry->running, 1); 
+    SDL_AtomicSet(&telemetry->dropped, 0); 
+    telemetry->thread = SDL_CreateThread(run_telemetry_thread, "telemetry", telemetry); 
+}
+
+void cleanup_telemetry(struct Telemetry *telemetry) {
+    SDL_AtomicSet(&telemetry->running, 0); 
+    SDL_WaitThread(telemetry->thread, NULL); 
+}
+
+// called on the game thread: a copy into the ring and an index publish, nothing else
+void record_attempt(struct Telemetry *telemetry, struct Attempt *attempt) {
+    unsigned write_i = SDL_AtomicGet(&telemetry->write_i); 
+    unsigned read_i = SDL_AtomicGet(&telemetry->read_i); 
+    if (write_i - read_i >= TELEMETRY_RING_SIZE) {
+        SDL_AtomicAdd(&telemetry->dropped, 1); 
+        return; 
+    }
+
+    telemetry->ring[write_i % TELEMETRY_RING_SIZE] = *attempt; 
+    SDL_AtomicSet(&telemetry->write_i, write_i + 1); // SDL atomics are full barriers, so the record is visible before the index
+}
+
+#endif
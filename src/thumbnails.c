@@ -0,0 +1,197 @@
+/*
+Offline thumbnail and screenshot tool. Renders every level in a directory with the real tile atlases, writing for each level
+a thumbnail png and a full map screenshot png, plus one atlas png of all the thumbnails with an index file of where each one is.
+
+usage: ./bin/thumbnails [level dir] [output dir]   (defaults to levels/official and thumbnails)
+
+Each thread has its own software renderer and surfaces, and threads just take the next level off a shared counter until they run out.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <SDL.h>
+#include <SDL_image.h>
+
+#include "lib.c"
+
+#define MAX_THREADS 64
+#define THUMBNAIL_SCALE 5 // pixels per tile
+#define SCREENSHOT_SCALE 32
+#define ATLAS_COLUMNS 8
+
+struct ThumbnailJobs {
+    char *level_dir; 
+    char *out_dir; 
+    int *ids; 
+    int num_ids; 
+    SDL_atomic_t next_i; 
+
+    SDL_Surface *atlas; // each level has its own slot so the threads never blit over each other
+}; 
+
+struct ThumbnailWorker {
+    struct ThumbnailJobs *jobs; 
+
+    SDL_Surface *thumbnail; 
+    SDL_Surface *screenshot; 
+    SDL_Renderer *thumbnail_renderer; 
+    SDL_Renderer *screenshot_renderer; 
+
+    // textures belong to a renderer, so every renderer gets its own copies
+    SDL_Texture *thumbnail_tiles[2]; 
+    SDL_Texture *screenshot_tiles[2]; 
+    SDL_Texture *screenshot_player; 
+}; 
+
+// draws one level (map and ship at the spawn) filling the renderer's surface
+void render_level_image(SDL_Renderer *renderer, SDL_Texture *tiles[2], SDL_Texture *player, SDL_Surface *surface, unsigned char map[MAP_H][MAP_W], float spawn_x, float spawn_y, float spawn_rot) {
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255); 
+    SDL_RenderClear(renderer); 
+    render_level_map(renderer, tiles[0], tiles[1], map, (SDL_Rect){0, 0, surface->w, surface->h}); 
+
+    if (player != NULL) {
+        // same ship size and anchor as the editor
+        float tile_w = (float)surface->w / MAP_W, tile_h = (float)surface->h / MAP_H; 
+        SDL_RenderCopyEx(renderer, player, NULL, &(SDL_Rect){(spawn_x - 0.125) * tile_w, surface->h - (spawn_y + 0.25) * tile_h, 0.5 * tile_w, 0.5 * tile_h}, spawn_rot * -180/M_PI, &(SDL_Point){0.125 * tile_w, 0.25 * tile_h}, SDL_FLIP_NONE); 
+    }
+    SDL_RenderFlush(renderer); 
+}
+
+int run_thumbnail_worker(void *data) {
+    struct ThumbnailWorker *worker = data; 
+    struct ThumbnailJobs *jobs = worker->jobs; 
+
+    for (int i = SDL_AtomicAdd(&jobs->next_i, 1); i < jobs->num_ids; i = SDL_AtomicAdd(&jobs->next_i, 1)) {
+        char path[256]; 
+        snprintf(path, sizeof(path), "%s/%d.lvl", jobs->level_dir, jobs->ids[i]); 
+        FILE *file = fopen(path, "rb"); 
+        if (file == NULL) continue; 
+
+        float spawn_x, spawn_y, spawn_rot; 
+        unsigned char map[MAP_H][MAP_W]; 
+        fseek(file, 32 * sizeof(char), SEEK_SET); // skip name
+        fread(&spawn_x, sizeof(float), 1, file); 
+        fread(&spawn_y, sizeof(float), 1, file); 
+        fread(&spawn_rot, sizeof(float), 1, file); 
+        fseek(file, sizeof(float), SEEK_CUR); // skip record
+        fread(map, sizeof(map), 1, file); 
+        fclose(file); 
+
+        // the ship is less than a pixel wide in the thumbnail, so it is only drawn in the screenshot
+        render_level_image(worker->thumbnail_renderer, worker->thumbnail_tiles, NULL, worker->thumbnail, map, spawn_x, spawn_y, spawn_rot); 
+        render_level_image(worker->screenshot_renderer, worker->screenshot_tiles, worker->screenshot_player, worker->screenshot, map, spawn_x, spawn_y, spawn_rot); 
+
+        snprintf(path, sizeof(path), "%s/%d.png", jobs->out_dir, jobs->ids[i]); 
+        IMG_SavePNG(worker->thumbnail, path); 
+        snprintf(path, sizeof(path), "%s/%d_full.png", jobs->out_dir, jobs->ids[i]); 
+        IMG_SavePNG(worker->screenshot, path); 
+
+        SDL_BlitSurface(worker->thumbnail, NULL, jobs->atlas, &(SDL_Rect){(i % ATLAS_COLUMNS) * worker->thumbnail->w, (i / ATLAS_COLUMNS) * worker->thumbnail->h, worker->thumbnail->w, worker->thumbnail->h}); 
+    }
+    return 0; 
+}
+
+void init_thumbnail_worker(struct ThumbnailWorker *worker, struct ThumbnailJobs *jobs) {
+    worker->jobs = jobs; 
+    worker->thumbnail = SDL_CreateRGBSurfaceWithFormat(0, MAP_W * THUMBNAIL_SCALE, MAP_H * THUMBNAIL_SCALE, 32, SDL_PIXELFORMAT_RGBA32); 
+    worker->screenshot = SDL_CreateRGBSurfaceWithFormat(0, MAP_W * SCREENSHOT_SCALE, MAP_H * SCREENSHOT_SCALE, 32, SDL_PIXELFORMAT_RGBA32); 
+    worker->thumbnail_renderer = SDL_CreateSoftwareRenderer(worker->thumbnail); 
+    worker->screenshot_renderer = SDL_CreateSoftwareRenderer(worker->screenshot); 
+
+    worker->thumbnail_tiles[0] = IMG_LoadTexture(worker->thumbnail_renderer, "assets/low_res_tiles.png"); 
+    worker->thumbnail_tiles[1] = IMG_LoadTexture(worker->thumbnail_renderer, "assets/high_res_tiles.png"); 
+    worker->screenshot_tiles[0] = IMG_LoadTexture(worker->screenshot_renderer, "assets/low_res_tiles.png"); 
+    worker->screenshot_tiles[1] = IMG_LoadTexture(worker->screenshot_renderer, "assets/high_res_tiles.png"); 
+    worker->screenshot_player = IMG_LoadTexture(worker->screenshot_renderer, "assets/space_ship.png"); 
+
+    // the thumbnail shrinks the tiles down a lot, so filter them
+    SDL_SetTextureScaleMode(worker->thumbnail_tiles[0], SDL_ScaleModeLinear); 
+    SDL_SetTextureScaleMode(worker->thumbnail_tiles[1], SDL_ScaleModeLinear); 
+    SDL_SetTextureScaleMode(worker->screenshot_tiles[1], SDL_ScaleModeLinear); 
+}
+
+void cleanup_thumbnail_worker(struct ThumbnailWorker *worker) {
+    SDL_DestroyTexture(worker->screenshot_player); 
+    SDL_DestroyTexture(worker->screenshot_tiles[1]); 
+    SDL_DestroyTexture(worker->screenshot_tiles[0]); 
+    SDL_DestroyTexture(worker->thumbnail_tiles[1]); 
+    SDL_DestroyTexture(worker->thumbnail_tiles[0]); 
+    SDL_DestroyRenderer(worker->screenshot_renderer); 
+    SDL_DestroyRenderer(worker->thumbnail_renderer); 
+    SDL_FreeSurface(worker->screenshot); 
+    SDL_FreeSurface(worker->thumbnail); 
+}
+
+int main(int argc, char *argv[]) {
+    struct ThumbnailJobs jobs; 
+    jobs.level_dir = argc > 1 ? argv[1]: "levels/official"; 
+    jobs.out_dir = argc > 2 ? argv[2]: "thumbnails"; 
+    mkdir(jobs.out_dir, 0755); 
+
+    // collect the level ids the same way the custom select does, sorted so the atlas order is stable
+    DIR *dir = opendir(jobs.level_dir); 
+    if (dir == NULL) {
+        fprintf(stderr, "could not open %s\n", jobs.level_dir); 
+        return EXIT_FAILURE; 
+    }
+    int capacity = 64; 
+    jobs.ids = malloc(capacity * sizeof(int)); 
+    jobs.num_ids = 0; 
+    struct dirent *file; 
+    while ((file = readdir(dir)) != NULL) {
+        int id; 
+        char extension[8]; 
+        if (sscanf(file->d_name, "%d.%7s", &id, extension) == 2 && strcmp(extension, "lvl") == 0) {
+            if (jobs.num_ids == capacity) jobs.ids = realloc(jobs.ids, (capacity *= 2) * sizeof(int)); 
+            jobs.ids[jobs.num_ids++] = id; 
+        }
+    }
+    closedir(dir); 
+    for (int i = 1; i < jobs.num_ids; ++i) {
+        int val = jobs.ids[i]; 
+        int j; 
+        for (j = i - 1; j >= 0 && jobs.ids[j] > val; --j) jobs.ids[j + 1] = jobs.ids[j]; 
+        jobs.ids[j + 1] = val; 
+    }
+
+    IMG_Init(IMG_INIT_PNG); 
+
+    int atlas_rows = (jobs.num_ids + ATLAS_COLUMNS - 1) / ATLAS_COLUMNS; 
+    jobs.atlas = SDL_CreateRGBSurfaceWithFormat(0, ATLAS_COLUMNS * MAP_W * THUMBNAIL_SCALE, (atlas_rows > 0 ? atlas_rows: 1) * MAP_H * THUMBNAIL_SCALE, 32, SDL_PIXELFORMAT_RGBA32); 
+    SDL_AtomicSet(&jobs.next_i, 0); 
+
+    int num_threads = SDL_GetCPUCount(); 
+    if (num_threads < 1) num_threads = 1; 
+    if (num_threads > MAX_THREADS) num_threads = MAX_THREADS; 
+    if (num_threads > jobs.num_ids) num_threads = jobs.num_ids > 0 ? jobs.num_ids: 1; 
+
+    struct ThumbnailWorker workers[MAX_THREADS]; 
+    SDL_Thread *threads[MAX_THREADS]; 
+    for (int i = 0; i < num_threads; ++i) init_thumbnail_worker(&workers[i], &jobs); 
+    for (int i = 0; i < num_threads; ++i) threads[i] = SDL_CreateThread(run_thumbnail_worker, "thumbnails", &workers[i]); 
+    for (int i = 0; i < num_threads; ++i) SDL_WaitThread(threads[i], NULL); 
+    for (int i = 0; i < num_threads; ++i) cleanup_thumbnail_worker(&workers[i]); 
+
+    // atlas image, then the index: thumbnail size and count, then the id of every slot in order (slots go left to right, top to bottom)
+    char path[256]; 
+    snprintf(path, sizeof(path), "%s/atlas.png", jobs.out_dir); 
+    IMG_SavePNG(jobs.atlas, path); 
+
+    snprintf(path, sizeof(path), "%s/atlas.dat", jobs.out_dir); 
+    FILE *index = fopen(path, "wb"); 
+    if (index != NULL) {
+        unsigned header[4] = {MAP_W * THUMBNAIL_SCALE, MAP_H * THUMBNAIL_SCALE, ATLAS_COLUMNS, jobs.num_ids}; 
+        fwrite(header, sizeof(header), 1, index); 
+        fwrite(jobs.ids, sizeof(int), jobs.num_ids, index); 
+        fclose(index); 
+    }
+    printf("rendered %d levels from %s into %s\n", jobs.num_ids, jobs.level_dir, jobs.out_dir); 
+
+    SDL_FreeSurface(jobs.atlas); 
+    free(jobs.ids); 
+    IMG_Quit(); 
+    return EXIT_SUCCESS; 
+}